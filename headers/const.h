@@ -11,9 +11,12 @@
 
 #define PROCESS_PRIO_LOW  0
 #define PROCESS_PRIO_HIGH 1
+#define MLFQ_LEVELS       4                 /* feedback levels of the PROCESS_PRIO_LOW processes */
+#define NPRIO             (MLFQ_LEVELS + 1) /* ready queues: the feedback levels + PROCESS_PRIO_HIGH */
 
 /* Number of semaphore's device */
 #define SEMDEVLEN 49
+#define N_DEVLINES 5 /* interrupt lines with devices (3..7), one device lock each */
 #define RECVD    5
 
 /* Hardware & software constants */
@@ -43,7 +46,22 @@
 
 /* Mikeyg Added constants */
 
+#ifndef MAXPROC
 #define MAXPROC 20
+#endif
+#define PCB_CACHE_MAX   4 /* free PCBs kept in the cache of a CPU before giving them back to the pool */
+#define PCB_CACHE_BATCH 2 /* PCBs taken from the pool when the cache is empty */
+
+#ifndef ASL_HASH_BITS
+#define ASL_HASH_BITS 5 /* the ASL has 1 << ASL_HASH_BITS buckets, at least MAXPROC */
+#endif
+
+/* p_state: where a PCB currently is */
+#define PCB_FREE    0 /* in a free list */
+#define PCB_READY   1 /* in a ready queue */
+#define PCB_RUNNING 2 /* CurrentProcess of the CPU p_lastCpu */
+#define PCB_BLOCKED 3 /* on a semaphore, or a periodic process waiting for its next period */
+#define PCB_NEW     4 /* allocated, not yet in the process tree: invisible to pidLookup */
 
 #define CREATEPROCESS -1
 #define TERMPROCESS   -2
@@ -55,6 +73,9 @@
 #define GETSUPPORTPTR -8
 #define GETPROCESSID  -9
 #define YIELD         -10
+#define SETAFFINITY   -11
+#define SETPERIODIC   -12
+#define WAITPERIOD    -13
 
 /* Status register constants */
 #define ALLOFF      0x00000000
@@ -132,6 +153,8 @@
 #define WRITEPRINTER 3
 #define WRITETERMINAL 4
 #define READTERMINAL 5
+#define SET_PERIODIC 6
+#define WAIT_PERIOD 7
 
 /* Index register constants */
 #define PRESENTFLAG 0x80000000
@@ -180,7 +203,13 @@
 #define BYTELENGTH 8
 
 #define PSECOND    100000
+#define TIMER_PARKED 0xFFFFFFFF /* timer value used to park a timer that is not needed */
+#define TOD_BEFORE(a, b) ((int)((a) - (b)) < 0) /* a comes before b, even across a TOD wraparound */
 #define TIMESLICE  5000 /* length of proc's time slice	*/
+#define MLFQ_BOOST SECOND /* period of the MLFQ priority boost */
+#define CFS_WAKEUP_GRAN 1000 /* vruntime lead a woken process needs to preempt (SCHED_FAIR) */
+#define BALANCE_INTERVAL 20000 /* period of the cross-CPU load balancer */
+#define BALANCE_BATCH    4 /* processes moved at most by a single balancing pass */
 #define NEVER      0x7FFFFFFF
 #define SECOND     1000000
 #define STATESIZE  0x8C
@@ -194,6 +223,8 @@
 #define MAXPAGES      32
 #define USERPGTBLSIZE MAXPAGES
 #define OSFRAMES      32
+#define SUPSTACKSIZE  500                /* words of each support level stack */
+#define SUPSTACKTOP   (SUPSTACKSIZE - 1) /* the stack pointer the handlers start with */
 
 // #define FLASHPOOLSTART (RAMSTART + (OSFRAMES * PAGESIZE))
 #define DISKPOOLSTART  (FLASHPOOLSTART + (DEVPERINT * PAGESIZE))
@@ -216,7 +247,30 @@
 
 #define NRSEMAPHORES 49         /* Numero semafori devices + pseudo clock */
 #define NSUPPSEM 48 		/* Numero di semafori devices per il livello di supporto */
+#ifndef NCPU
 #define NCPU 8 /* Numero di processori attivi */
+#endif
+
+/* Politiche di scheduling selezionabili a tempo di compilazione */
+#define SCHED_MLFQ 0 /* multi-level feedback queue */
+#define SCHED_FAIR 1 /* completely fair: virtual runtime in un red-black tree */
+#ifndef SCHED_POLICY
+#define SCHED_POLICY SCHED_MLFQ
+#endif
+
+/* Maschera di affinita' che comprende tutti i processori */
+#define ALLCPUS_MASK ((1U << NCPU) - 1)
+
+/* 1: una ready queue per processore con work stealing, 0: singola ready queue condivisa */
+#ifndef PERCPU_READYQUEUE
+#define PERCPU_READYQUEUE 1
+#endif
+
+/* 1: profilo dei lock per call site, stampato sul terminale 0 allo spegnimento */
+#ifndef LOCK_PROFILE
+#define LOCK_PROFILE 0
+#endif
+#define LOCKPROF_TERMADDR 0x10000254 /* registri del terminale 0 */
 
 #define DISKBACK     1
 #define FLASHBACK    0
@@ -224,6 +278,19 @@
 
 #define UPROCMAX 8
 #define POOLSIZE (UPROCMAX * 2)
+
+#define SWAP_POOL_SIZE      (2 * UPROCMAX)
+#define SWAP_POOL_STARTADDR (RAMSTART + (64 * PAGESIZE) + (NCPU * PAGESIZE))
+
+/* 1: PCB e semd oltre MAXPROC allocati da slab nei frame di RAM liberi (p1test si aspetta 0) */
+#ifndef DYNAMIC_POOLS
+#define DYNAMIC_POOLS 0
+#endif
+#define SLAB_FRAMESTART  (SWAP_POOL_STARTADDR + SWAP_POOL_SIZE * PAGESIZE) /* primo frame dopo lo swap pool */
+#define SLAB_STACKFRAMES 16   /* frame sotto RAMTOP lasciati agli stack dei processi di test */
+#define SLAB_MAXFRAMES   1024 /* frame gestibili dall'allocatore degli slab (4 MB) */
+#define SLAB_PRESSURE    4    /* sotto questi frame liberi gli slab vuoti vengono subito restituiti */
+#define SLAB_MAXCACHES   3    /* PCB, stati salvati dei PCB e semd */
 /* End of Mikeyg constants */
 
 #define CHARRECV			5		/* Character received*/
@@ -241,4 +308,9 @@
 #define IRT_NUM_ENTRY 48
 /* Task Priority Register */
 #define TPR 0x10000408 
+/* Inter-processor interrupts: Inbox (scriverci per fare l'ACK) e Outbox (destinatari << 8 | messaggio) */
+#define INBOX  0x10000400
+#define OUTBOX 0x10000404
+#define IPI_RECIPIENTS_SHIFT 8
+#define IPI_WAKEUP 1
 #endif
@@ -6,7 +6,7 @@
 #ifndef NULL
 #define NULL ((void *)0)
 #endif
-typedef unsigned int size_tt;
+typedef __SIZE_TYPE__ size_tt; /* unsigned int on uriscv, as wide as a pointer on the host build */
 
 /*
     Macro che restituisce il puntatore all'istanza della struttura che contiene
@@ -159,6 +159,20 @@ static inline void list_del(struct list_head *entry) {
     entry->prev = entry;
 }
 
+/*
+    Sposta l'elemento entry dalla lista in cui e' contenuto in testa alla
+    lista head.
+
+    entry: elemento da spostare
+    head: lista di destinazione
+
+    return: void
+*/
+static inline void list_move(struct list_head *entry, struct list_head *head) {
+    __list_del(entry->prev, entry->next);
+    list_add(entry, head);
+}
+
 /*
     Funzione che controlla se la lista e' arrivata alla fine
 
@@ -0,0 +1,65 @@
+/* intrusive red-black tree, modelled on the Linux Kernel "include/linux/rbtree.h" */
+#ifndef RBTREE_H_INCLUDED
+#define RBTREE_H_INCLUDED
+
+#include "./listx.h"
+
+#define RB_RED   0
+#define RB_BLACK 1
+
+/*
+    Nodo dell'albero: come per list_head basta inserirlo come campo della
+    struttura da ordinare e ricavare la struttura con rb_entry.
+*/
+struct rb_node {
+    struct rb_node *rb_parent, *rb_left, *rb_right;
+    int rb_color;
+};
+
+/* Radice dell'albero, vuoto quando rb_node e' NULL */
+struct rb_root {
+    struct rb_node *rb_node;
+};
+
+#define RB_ROOT_INIT \
+    { NULL }
+
+/*
+    Macro che restituisce il puntatore alla struttura che contiene il nodo ptr
+    (vedi container_of).
+*/
+#define rb_entry(ptr, type, member) container_of(ptr, type, member)
+
+/*
+    Funzione inline che aggancia node come figlio di parent nel puntatore link
+    (&parent->rb_left o &parent->rb_right, oppure &root->rb_node se l'albero e'
+    vuoto). La discesa per trovare parent e link e' a carico del chiamante,
+    che conosce la chiave; dopo va chiamata rb_insert_color.
+
+    node: nodo da inserire
+    parent: futuro padre di node
+    link: puntatore in cui agganciare node
+*/
+static inline void rb_link_node(struct rb_node *node, struct rb_node *parent, struct rb_node **link) {
+    node->rb_parent = parent;
+    node->rb_left   = NULL;
+    node->rb_right  = NULL;
+    node->rb_color  = RB_RED;
+    *link           = node;
+}
+
+/*
+    Funzione inline che controlla se l'albero root e' vuoto.
+
+    return: 1 se l'albero e' vuoto, 0 altrimenti
+*/
+static inline int rb_empty(const struct rb_root *root) {
+    return root->rb_node == NULL;
+}
+
+void rb_insert_color(struct rb_node *node, struct rb_root *root);
+void rb_erase(struct rb_node *node, struct rb_root *root);
+struct rb_node *rb_first(const struct rb_root *root);
+struct rb_node *rb_next(const struct rb_node *node);
+
+#endif
@@ -9,6 +9,7 @@
 #include <uriscv/types.h>
 #include "./const.h"
 #include "./listx.h"
+#include "./rbtree.h"
 
 typedef signed int cpu_t;
 typedef unsigned int memaddr;
@@ -36,8 +37,8 @@ typedef struct support_t
     context_t sup_exceptContext[2];             /* new contexts for passing up	*/
     pteEntry_t sup_privatePgTbl[USERPGTBLSIZE]; /* user page table				*/
     struct list_head s_list;
-    unsigned int sup_stackTLB[500];
-    unsigned int sup_stackGen[500];
+    unsigned int sup_stackTLB[SUPSTACKSIZE];
+    unsigned int sup_stackGen[SUPSTACKSIZE];
 } support_t;
 
 /* Page swap pool information structure type */
@@ -48,30 +49,150 @@ typedef struct swap_t
     pteEntry_t *sw_pte; /* page's PTE entry.	*/
 } swap_t;
 
-/* process table entry type */
+/* process table entry type
+ * The fields read while walking the queues and by the scheduler come first,
+ * packed together; the saved processor state is in a separate cold area
+ * (see pcb.c) and p_s points to it. */
 typedef struct pcb_t {
     /* process queue  */
     struct list_head p_list;
 
+    /* process id */
+    int p_pid;
+    int p_state; /* PCB_FREE, PCB_READY, PCB_RUNNING or PCB_BLOCKED */
+
+    /* Pointer to the semaphore the process is currently blocked on */
+    int *p_semAdd;
+
+    cpu_t p_time; /* cpu time used by proc */
+
+    /* scheduling priority (PROCESS_PRIO_LOW/PROCESS_PRIO_HIGH) */
+    int p_prio;
+
+    /* MLFQ level (0 is the highest) and boost epoch it refers to */
+    int          p_level;
+    unsigned int p_boostEpoch;
+
+    /* CPU the process last ran on (-1 if never) and CPUs it may run on (bit i = CPU i) */
+    int          p_lastCpu;
+    unsigned int p_affinity;
+
+    /* ready queue holding the process (NULL if none), written under its rq_lock */
+    struct readyq_t *p_rq;
+
+    /* fair scheduling: ready tree node, virtual runtime, p_time when it was last charged
+       and rq_minVruntime of the queue p_vruntime refers to */
+    struct rb_node p_node;
+    cpu_t          p_vruntime;
+    cpu_t          p_dispatchTime;
+    cpu_t          p_vbase;
+
+    /* EDF real-time class (p_period is 0 for normal processes), times in TOD ticks */
+    cpu_t        p_period;     /* length of a period */
+    cpu_t        p_budget;     /* CPU time granted in every period */
+    cpu_t        p_budgetLeft; /* budget left in the current period */
+    cpu_t        p_deadline;   /* end of the current period (and start of the next) */
+    cpu_t        p_charged;    /* p_time already charged to the budget */
+    unsigned int p_missed;     /* number of deadlines missed */
+
     /* process tree fields */
     struct pcb_t    *p_parent; /* ptr to parent	*/
     struct list_head p_child;  /* children list */
     struct list_head p_sib;    /* sibling list  */
 
-    /* process status information */
-    state_t p_s;    /* processor state */
-    cpu_t   p_time; /* cpu time used by proc */
-
-    /* Pointer to the semaphore the process is currently blocked on */
-    int *p_semAdd;
-
     /* Pointer to the support struct */
     support_t *p_supportStruct;
 
-    /* process id */
-    int p_pid;
+    /* process status information: the processor state, in the cold area */
+    state_t *p_s;
 } pcb_t, *pcb_PTR;
 
+/* slab: one RAM frame holding objects of a slabcache_t, this header comes first */
+typedef struct slab_t {
+    struct list_head    sb_link;  /* in the partial, full or empty list of its cache */
+    struct slabcache_t* sb_cache;
+    int                 sb_inUse; /* objects allocated */
+    void*               sb_free;  /* free objects, linked through their first word */
+} slab_t;
+
+/* slab allocator of objects of one size (DYNAMIC_POOLS) */
+typedef struct slabcache_t {
+    unsigned int     sc_lock;               /* ACQUIRE_LOCK word protecting the lists */
+    unsigned int     sc_objSize;
+    int              sc_perSlab;            /* objects in a slab */
+    void (*sc_ctor)(void* obj, int index);  /* called on every object of a new slab */
+    struct list_head sc_partial;            /* slabs with some free objects */
+    struct list_head sc_full;
+    struct list_head sc_empty;              /* at most one spare slab with no objects in use */
+    unsigned int     sc_slabs;              /* slabs (frames) owned */
+    unsigned int     sc_grows;
+    unsigned int     sc_shrinks;
+} slabcache_t;
+
+/* lock profiler: counters of one spinLock call site, one slot per CPU (LOCK_PROFILE) */
+typedef struct lockprof_t {
+    const char*        lp_file;               /* call site */
+    int                lp_line;
+    int                lp_registered;         /* 1 once linked in the list of the call sites */
+    struct lockprof_t* lp_next;               /* next call site in the list */
+    unsigned int       lp_acquisitions[NCPU];
+    unsigned int       lp_waitTime[NCPU];     /* TOD ticks spent waiting for the lock */
+    unsigned int       lp_maxWait[NCPU];
+    unsigned int       lp_holdTime[NCPU];     /* TOD ticks from acquisition to release */
+} lockprof_t;
+
+/* fair (FIFO) ticket spinlock built on ACQUIRE_LOCK, with contention counters */
+typedef struct spinlock_t {
+    unsigned int          sl_guard;        /* ACQUIRE_LOCK word protecting sl_next */
+    volatile unsigned int sl_next;         /* next ticket to hand out */
+    volatile unsigned int sl_serving;      /* ticket of the current (or next) holder */
+    unsigned int          sl_acquisitions; /* times the lock has been taken */
+    unsigned int          sl_contended;    /* acquisitions that had to wait */
+    unsigned int          sl_spins;        /* total wait iterations */
+    unsigned int          sl_maxSpins;     /* longest single wait */
+#if LOCK_PROFILE
+    lockprof_t*           sl_site;         /* call site of the current holder */
+    int                   sl_cpu;          /* CPU of the current holder */
+    cpu_t                 sl_acquiredTOD;  /* TOD when the current holder got the lock */
+#endif
+} spinlock_t;
+
+/* ready queue of a single CPU */
+typedef struct readyq_t {
+#if SCHED_POLICY == SCHED_FAIR
+    struct rb_root   rq_tree;         /* runnable processes ordered by p_vruntime */
+    struct rb_node  *rq_leftmost;     /* first node of rq_tree (next to run) */
+    cpu_t            rq_minVruntime;  /* monotonic lower bound of the p_vruntime in rq_tree */
+#else
+    struct list_head rq_procq[NPRIO]; /* runnable processes, one FIFO per queue level */
+    unsigned int     rq_bitmap;       /* bit set iff the matching rq_procq is not empty */
+#endif
+    spinlock_t       rq_lock;         /* protects the fields above and rq_count */
+    int              rq_count;        /* number of processes in the ready queue */
+} readyq_t;
+
+/* per-CPU state: lock and time accounting */
+typedef struct cpustat_t {
+    spinlock_t cs_lock; /* protects CurrentProcess[cpu]: taken by the CPU to switch process, by the others to look at it */
+    cpu_t cs_chargeTOD; /* TOD since which the running process has not been charged */
+    int   cs_idle;      /* 1 while the CPU is parked in WAIT() */
+    cpu_t cs_idleSince; /* TOD when the CPU went idle, valid while cs_idle */
+    cpu_t cs_idleTime;  /* total time spent idle */
+    cpu_t cs_busyTime;  /* total time charged to processes */
+} cpustat_t;
+
+/* load balancer counters, to be traced while tuning BALANCE_INTERVAL and BALANCE_BATCH */
+typedef struct balancestat_t {
+    unsigned int bs_runs;             /* balancing passes */
+    unsigned int bs_migrations;       /* processes moved between CPUs */
+    unsigned int bs_migrationsPerSec; /* processes moved during the last full second */
+    unsigned int bs_imbalance;        /* load difference found by the last pass */
+    unsigned int bs_maxImbalance;     /* largest load difference ever found */
+    unsigned int bs_load[NCPU];       /* runnable load of every CPU at the last pass */
+    cpu_t        bs_windowStart;      /* TOD when the current second started */
+    unsigned int bs_windowMigrations; /* processes moved during the current second */
+} balancestat_t;
+
 /* semaphore descriptor (SEMD) data structure */
 typedef struct semd_t {
     /* Semaphore key */
@@ -0,0 +1,44 @@
+/*
+    Stand-in for <uriscv/const.h> used by the host build (host/CMakeLists.txt):
+    only the constants needed by the kernel headers, with the same values as
+    the uriscv ones. The TOD is read from the host clock (see liburiscv.c).
+*/
+#ifndef URISCV_CONST_H
+#define URISCV_CONST_H
+
+#define DEVINTNUM     5
+#define DEVPERINT     8
+#define DEVREGLEN     4
+#define DEVREGSIZE    16
+#define STATE_GPR_LEN 32
+
+/* device register fields and status codes */
+#define STATUS      0
+#define COMMAND     1
+#define DATA0       2
+#define DATA1       3
+#define RECVSTATUS  0
+#define RECVCOMMAND 1
+#define TRANSTATUS  2
+#define TRANCOMMAND 3
+#define RESET       0
+#define ACK         1
+#define PRINTCHR    2
+#define READY       1
+#define BUSY        3
+
+#define TRUE  1
+#define FALSE 0
+#define EOS   '\0'
+
+#ifndef NULL
+#define NULL ((void *)0)
+#endif
+
+#define CAUSE_IS_INT(cause) ((cause) & 0x80000000)
+
+/* TOD in microseconds (the timescale is 1 tick per microsecond) */
+unsigned int hostTOD(void);
+#define STCK(T) ((T) = hostTOD())
+
+#endif
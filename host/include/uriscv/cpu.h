@@ -0,0 +1,10 @@
+/*
+    Stand-in for <uriscv/cpu.h> used by the host build: the kernel only
+    needs the processor state, which is in types.h.
+*/
+#ifndef URISCV_CPU_H
+#define URISCV_CPU_H
+
+#include "./types.h"
+
+#endif
@@ -0,0 +1,67 @@
+/*
+    Stand-in for <uriscv/liburiscv.h> used by the host build.
+    liburiscv.c implements the services that phase 1 needs on top of the
+    host atomics; machine.c simulates the rest of the processor for phase 2
+    (see host/CMakeLists.txt). getPRID returns the CPU of the calling host
+    thread, set with hostSetPRID (0 by default).
+*/
+#ifndef URISCV_LIBURISCV_H
+#define URISCV_LIBURISCV_H
+
+#include "./types.h"
+
+unsigned int getPRID(void);
+void         hostSetPRID(unsigned int prid);
+
+int  CAS(unsigned int *atomic, unsigned int ov, unsigned int nv);
+void ACQUIRE_LOCK(unsigned int *lock);
+void RELEASE_LOCK(unsigned int *lock);
+
+void PANIC(void);
+void HALT(void);
+
+/* processor registers and services simulated by machine.c */
+unsigned int getCAUSE(void);
+unsigned int getSTATUS(void);
+void         setSTATUS(unsigned int status);
+unsigned int getMIE(void);
+void         setMIE(unsigned int mie);
+unsigned int getTIMER(void);
+void         setTIMER(unsigned int timer);
+
+void LDST(state_t *statep);
+void LDCXT(unsigned int stackPtr, unsigned int status, unsigned int pc);
+void WAIT(void);
+void INITCPU(unsigned int cpuid, state_t *start_state);
+
+void setENTRYHI(unsigned int entryHi);
+void setENTRYLO(unsigned int entryLo);
+void TLBWR(void);
+void TLBCLR(void);
+
+unsigned int SYSCALL(unsigned int number, unsigned int arg1, unsigned int arg2, unsigned int arg3);
+
+/*
+    Host only: the processes of the simulated machine are host code and can
+    be interrupted only when they call into it. hostPoll takes the pending
+    interrupts (time slice, IPIs, timers, devices), SYSCALL does the same
+    before the system call: CPU-bound loops should call hostPoll.
+*/
+void hostPoll(void);
+
+/*
+    Host only: called by ACQUIRE_LOCK and the kernel spinlocks while waiting
+    (CPU_RELAX in phase2/spinlock.c). The simulated CPUs are threads that may
+    outnumber the host cores, and a FIFO lock whose next holder is off the
+    host core stops all the others: the waiting thread gives up the core.
+*/
+void hostRelax(void);
+
+/*
+    Host only: sends the IPIs of word (an OUTBOX word) right away, latching
+    one on every recipient (SEND_IPI in phase2/scheduler.c): two IPIs sent
+    together to different CPUs are both delivered.
+*/
+void hostSendIpi(unsigned int word);
+
+#endif
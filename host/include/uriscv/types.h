@@ -0,0 +1,63 @@
+/*
+    Stand-in for <uriscv/types.h> used by the host build: the processor
+    state and the device registers with the uriscv layout.
+*/
+#ifndef URISCV_TYPES_H
+#define URISCV_TYPES_H
+
+#include "./const.h"
+
+typedef struct state {
+    unsigned int entry_hi;
+    unsigned int cause;
+    unsigned int status;
+    unsigned int pc_epc;
+    unsigned int mie;
+    unsigned int gpr[STATE_GPR_LEN];
+} state_t;
+
+#define reg_ra gpr[0]
+#define reg_sp gpr[1]
+#define reg_gp gpr[2]
+#define reg_tp gpr[3]
+#define reg_t0 gpr[4]
+#define reg_t1 gpr[5]
+#define reg_t2 gpr[6]
+#define reg_s0 gpr[7]
+#define reg_s1 gpr[8]
+#define reg_a0 gpr[9]
+#define reg_a1 gpr[10]
+#define reg_a2 gpr[11]
+#define reg_a3 gpr[12]
+#define reg_a4 gpr[13]
+#define reg_a5 gpr[14]
+#define reg_a6 gpr[15]
+#define reg_a7 gpr[16]
+
+typedef struct passupvector {
+    unsigned int tlb_refill_handler;
+    unsigned int tlb_refill_stackPtr;
+    unsigned int exception_handler;
+    unsigned int exception_stackPtr;
+} passupvector_t;
+
+typedef struct dtpreg {
+    unsigned int status;
+    unsigned int command;
+    unsigned int data0;
+    unsigned int data1;
+} dtpreg_t;
+
+typedef struct termreg {
+    unsigned int recv_status;
+    unsigned int recv_command;
+    unsigned int transm_status;
+    unsigned int transm_command;
+} termreg_t;
+
+typedef union devreg {
+    dtpreg_t  dtp;
+    termreg_t term;
+} devreg_t;
+
+#endif
@@ -0,0 +1,55 @@
+/*
+    Host implementation of the liburiscv services needed by phase 1, declared
+    in include/uriscv/liburiscv.h; the simulated processor is in machine.c.
+*/
+#include <uriscv/const.h>
+#include <uriscv/liburiscv.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static __thread unsigned int prid;
+
+unsigned int getPRID(void) {
+    return prid;
+}
+
+void hostSetPRID(unsigned int p) {
+    prid = p;
+}
+
+int CAS(unsigned int *atomic, unsigned int ov, unsigned int nv) {
+    return __atomic_compare_exchange_n(atomic, &ov, nv, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+/* a short sleep: sched_yield may hand the core straight back to the caller */
+void hostRelax(void) {
+    struct timespec nap = {0, 1000};
+
+    nanosleep(&nap, NULL);
+}
+
+/* the holder may be off the host core: the waiting thread gives it up */
+void ACQUIRE_LOCK(unsigned int *lock) {
+    while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE))
+        while (__atomic_load_n(lock, __ATOMIC_RELAXED))
+            hostRelax();
+}
+
+void RELEASE_LOCK(unsigned int *lock) {
+    __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+void PANIC(void) {
+    fprintf(stderr, "PANIC on CPU %u\n", prid);
+    abort();
+}
+
+/* the TOD wraps around like the uriscv one: the kernel compares it with TOD_BEFORE */
+unsigned int hostTOD(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
@@ -0,0 +1,582 @@
+/*
+    Simulated uriscv machine for the host build of phase 2.
+
+    Every CPU is a host thread running the kernel on its own stack: LDST,
+    WAIT and the exception entry jump back to the top of that stack, like a
+    real CPU that reloads its kernel stack pointer on every exception.
+    The processes are host functions, each with its own context (ucontext)
+    and stack in the simulated RAM; reg_tp of their saved state tells which
+    context a state belongs to, so the states created by the kernel or by
+    the test must have reg_tp 0. A process traps into the kernel when it
+    calls SYSCALL or hostPoll, which are also the only points where it can
+    be interrupted.
+
+    The bus registers, the BIOS data page and the RAM are mapped at their
+    uriscv addresses and the program is linked without PIE, so the kernel
+    can keep addresses in 32 bit words as it does on uriscv. A bus thread
+    plays the hardware: it updates the TOD, counts down the interval timer
+    and completes the terminal and printer commands. The interrupt lines are level triggered: a CPU that
+    takes one claims it until the kernel acknowledges it. Only the CPUs the
+    IRT routes a device (or the interval timer) to can take its interrupt.
+    The kernel sends its IPIs through hostSendIpi (SEND_IPI), which latches
+    one on every recipient at once, so no IPI is lost or merged with another.
+    An idle CPU only wakes up for an interrupt: if it stays in WAIT for
+    LOST_WAKEUP_NS while its own ready queue holds processes, the kernel
+    lost a wakeup and the machine fails.
+*/
+#define _GNU_SOURCE
+#include <uriscv/const.h>
+#include <uriscv/liburiscv.h>
+#include <uriscv/types.h>
+
+#include "../headers/const.h"
+#include "../headers/types.h"
+#include "../phase1/headers/pcb.h"
+
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <ucontext.h>
+
+#define RAMSIZE        (64 * 1024 * 1024)
+#define PROCSTACKBASE  (RAMSTART + 1024 * 1024) /* the first MB is left to the kernel stacks of uriscv */
+#define PROCSTACKSIZE  (64 * 1024)
+#define NHOSTPROC      ((RAMSIZE - 1024 * 1024) / PROCSTACKSIZE)
+#define BUSPAGE        0x10000000
+#define INTDEVBITMAP   0x10000040
+#define IRT_DEST_MASK  0xFF
+#define BUS_PERIOD_NS  20000
+#define WAIT_TIMEOUT_NS 2000000
+#define LOST_WAKEUP_NS  100000000ULL
+
+#define CAUSE_INT      0x80000000
+#define CAUSE_SYSCALL  8
+
+#define CPU_RUN  1 /* longjmp to the kernel stack: run the process loaded by LDST */
+#define CPU_TRAP 2 /* longjmp to the kernel stack: enter exceptionHandler */
+
+#define TERMLINE     7
+#define PRINTERLINE  6
+#define TRANSMITTED  5
+#define LINEBUF      256
+
+extern void exceptionHandler(void);
+extern int  kernelMain(void); /* main of initial.c, renamed by host/CMakeLists.txt */
+extern pcb_t* CurrentProcess[NCPU];
+extern readyq_t ReadyQueue[NCPU];
+
+/* a process of the simulated machine */
+typedef struct hostproc {
+    ucontext_t   hp_ctx;
+    void       (*hp_entry)(void);
+    pcb_t       *hp_pcb;     /* PCB that loaded the context the first time */
+    int          hp_pid;
+    int          hp_used;
+    volatile int hp_running; /* a CPU is executing it: its stack is in use */
+} hostproc_t;
+
+/* a CPU of the simulated machine */
+typedef struct hostcpu {
+    pthread_t       hc_thread;
+    jmp_buf         hc_kernel; /* top of the kernel stack */
+    ucontext_t      hc_loop;   /* context of the CPU while a process runs */
+    void          (*hc_start)(void);
+    state_t         hc_loaded; /* state loaded by the last LDST */
+    hostproc_t     *hc_proc;
+    unsigned int    hc_cause;
+    unsigned int    hc_status;
+    unsigned int    hc_mie;
+    unsigned int    hc_timer; /* TOD of the PLT expiry */
+    int             hc_timerParked;
+    volatile int    hc_ipi;
+    pthread_mutex_t hc_mutex;
+    pthread_cond_t  hc_wakeup;
+} hostcpu_t;
+
+/* output line of a terminal or printer */
+typedef struct hostline {
+    char buf[LINEBUF];
+    int  len;
+} hostline_t;
+
+static hostcpu_t       Cpus[NCPU];
+static hostproc_t      Procs[NHOSTPROC];
+static pthread_mutex_t ProcsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static volatile unsigned int LinesClaimed; /* bit i: a CPU is handling interrupt line i */
+static volatile int          TimerPending; /* the interval timer went past zero */
+static volatile int          DevPending[N_DEVLINES][DEVPERINT];
+static hostline_t            DevOutput[N_DEVLINES][DEVPERINT];
+
+static pthread_mutex_t HaltMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  HaltCond  = PTHREAD_COND_INITIALIZER;
+static int             Halted;
+
+#define REG(addr)    (*(volatile unsigned int *)(uintptr_t)(addr))
+#define DEVBASE(l, d) (START_DEVREG + ((l) - 3) * 0x80 + (d) * DEVREGSIZE)
+
+static inline hostcpu_t *_self(void) {
+    return &Cpus[getPRID()];
+}
+
+static void _wakeAll(void) {
+    for (int i = 0; i < NCPU; i++) {
+        pthread_mutex_lock(&Cpus[i].hc_mutex);
+        pthread_cond_signal(&Cpus[i].hc_wakeup);
+        pthread_mutex_unlock(&Cpus[i].hc_mutex);
+    }
+}
+
+/*
+    Tells if the IRT routes one of the devs (bitmap) of line to the CPU cpuid:
+    with RP set the destination is a mask of CPUs, otherwise a CPU number.
+*/
+static int _routedTo(int cpuid, int line, unsigned int devs) {
+    for (int dev = 0; dev < DEVPERINT; dev++) {
+        if (!(devs & (1U << dev))) continue;
+        unsigned int entry = REG(IRT_START + ((line - 2) * DEVPERINT + dev) * WORDLEN);
+        if ((entry & IRT_RP_BIT_ON) ? (entry & (1U << cpuid)) != 0 : (entry & IRT_DEST_MASK) == cpuid) return 1;
+    }
+    return 0;
+}
+
+/*
+    Returns the cause of the highest priority interrupt pending for cpu and
+    enabled, 0 if there is none. inWait: the CPU is in WAIT, so the kernel
+    status and mie registers apply instead of those of the loaded process.
+*/
+static unsigned int _pendingInterrupt(hostcpu_t *cpu, int inWait) {
+    unsigned int status = inWait ? cpu->hc_status : cpu->hc_loaded.status;
+    unsigned int mie    = inWait ? cpu->hc_mie : cpu->hc_loaded.mie;
+    unsigned int enabled = inWait ? (status & MSTATUS_MIE_MASK) : (status & MSTATUS_MPIE_MASK);
+
+    if (!enabled) return 0;
+
+    if (cpu->hc_ipi && __atomic_exchange_n(&cpu->hc_ipi, 0, __ATOMIC_ACQ_REL)) return CAUSE_INT | IL_IPI;
+
+    if ((mie & MIE_MTIE_MASK) && !cpu->hc_timerParked && !TOD_BEFORE(hostTOD(), cpu->hc_timer)) return CAUSE_INT | IL_CPUTIMER;
+
+    int cpuid = cpu - Cpus;
+
+    if (TimerPending && _routedTo(cpuid, 2, 1) && !(__atomic_fetch_or(&LinesClaimed, 1U << 2, __ATOMIC_ACQ_REL) & (1U << 2))) return CAUSE_INT | IL_TIMER;
+
+    for (int line = 3; line < 3 + N_DEVLINES; line++) {
+        unsigned int devs = REG(INTDEVBITMAP + (line - 3) * WORDLEN);
+        if (devs && _routedTo(cpuid, line, devs) && !(__atomic_fetch_or(&LinesClaimed, 1U << line, __ATOMIC_ACQ_REL) & (1U << line))) {
+            return CAUSE_INT | (IL_DISK + line - 3);
+        }
+    }
+    return 0;
+}
+
+/* Gives a free host context to a new process, collecting those of the terminated ones if needed */
+static hostproc_t *_procAlloc(void) {
+    hostproc_t *p = NULL;
+
+    pthread_mutex_lock(&ProcsMutex);
+    for (int pass = 0; pass < 2 && !p; pass++) {
+        for (int i = 0; i < NHOSTPROC; i++) {
+            if (!Procs[i].hp_used) {
+                p = &Procs[i];
+                break;
+            }
+            // a context is dead once its pid no longer leads to its PCB
+            if (pass == 1 && !Procs[i].hp_running && pidLookup(Procs[i].hp_pid) != Procs[i].hp_pcb) {
+                Procs[i].hp_used = 0;
+            }
+        }
+    }
+    if (!p) {
+        fprintf(stderr, "machine: out of host contexts\n");
+        PANIC();
+    }
+    p->hp_used = 1;
+    pthread_mutex_unlock(&ProcsMutex);
+    return p;
+}
+
+static void _procStart(void) {
+    _self()->hc_proc->hp_entry();
+
+    fprintf(stderr, "machine: a process returned from its entry point\n");
+    PANIC();
+}
+
+/* Returns the host context of the state loaded by LDST, making a new one for a new process */
+static hostproc_t *_procOf(hostcpu_t *cpu) {
+    if (cpu->hc_loaded.reg_tp) return &Procs[cpu->hc_loaded.reg_tp - 1];
+
+    hostproc_t *p = _procAlloc();
+    int         i = p - Procs;
+
+    p->hp_entry = (void (*)(void))(uintptr_t)cpu->hc_loaded.pc_epc;
+    p->hp_pcb   = CurrentProcess[getPRID()];
+    p->hp_pid   = p->hp_pcb ? p->hp_pcb->p_pid : 0;
+
+    getcontext(&p->hp_ctx);
+    p->hp_ctx.uc_stack.ss_sp   = (void *)(uintptr_t)(PROCSTACKBASE + i * PROCSTACKSIZE);
+    p->hp_ctx.uc_stack.ss_size = PROCSTACKSIZE;
+    p->hp_ctx.uc_link          = NULL;
+    makecontext(&p->hp_ctx, _procStart, 0);
+
+    cpu->hc_loaded.reg_tp = i + 1;
+    return p;
+}
+
+/*
+    Enters the kernel from the running process: the exception state gets
+    the loaded state with the cause (and the syscall arguments), then the
+    CPU goes back to its kernel stack. Returns a0 of the state the process
+    is resumed with, possibly on another CPU.
+*/
+static unsigned int _trap(unsigned int cause, unsigned int a0, unsigned int a1, unsigned int a2, unsigned int a3) {
+    hostcpu_t  *cpu = _self();
+    hostproc_t *p   = cpu->hc_proc;
+    state_t    *es  = GET_EXCEPTION_STATE_PTR(getPRID());
+
+    *es       = cpu->hc_loaded;
+    es->cause = cause;
+    if (cause == CAUSE_SYSCALL) {
+        es->reg_a0 = a0;
+        es->reg_a1 = a1;
+        es->reg_a2 = a2;
+        es->reg_a3 = a3;
+    }
+    cpu->hc_cause  = cause;
+    cpu->hc_status = cpu->hc_loaded.status & ~MSTATUS_MIE_MASK;
+
+    swapcontext(&p->hp_ctx, &cpu->hc_loop);
+
+    return _self()->hc_loaded.reg_a0;
+}
+
+void hostPoll(void) {
+    unsigned int cause = _pendingInterrupt(_self(), 0);
+
+    if (cause) _trap(cause, 0, 0, 0, 0);
+}
+
+unsigned int SYSCALL(unsigned int number, unsigned int arg1, unsigned int arg2, unsigned int arg3) {
+    hostPoll();
+    return _trap(CAUSE_SYSCALL, number, arg1, arg2, arg3);
+}
+
+/*
+    Tells whether the process loaded by LDST has been taken away from this
+    CPU by terminateProcess on another CPU, after the kernel decided to run
+    it. On uriscv the kick IPI would interrupt it at once; here the IPI is
+    taken before entering its context, which may already belong to another
+    process once the PCB has been freed.
+*/
+static int _takenAway(hostcpu_t *cpu) {
+    state_t *es = GET_EXCEPTION_STATE_PTR(getPRID());
+
+    if (__atomic_load_n(&CurrentProcess[getPRID()], __ATOMIC_SEQ_CST)) return 0;
+
+    *es            = cpu->hc_loaded;
+    es->cause      = CAUSE_INT | IL_IPI;
+    cpu->hc_cause  = es->cause;
+    cpu->hc_status = cpu->hc_loaded.status & ~MSTATUS_MIE_MASK;
+    return 1;
+}
+
+static void *_cpuMain(void *arg) {
+    hostcpu_t *cpu = arg;
+
+    hostSetPRID(cpu - Cpus);
+    switch (setjmp(cpu->hc_kernel)) {
+        case 0:
+            cpu->hc_start();
+            PANIC();
+            break;
+        case CPU_RUN:
+            if (_takenAway(cpu)) break;
+            cpu->hc_proc = _procOf(cpu);
+            __atomic_store_n(&cpu->hc_proc->hp_running, 1, __ATOMIC_SEQ_CST);
+            // the context is safe from _procAlloc only from here on
+            if (_takenAway(cpu)) {
+                cpu->hc_proc->hp_running = 0;
+                break;
+            }
+            swapcontext(&cpu->hc_loop, &cpu->hc_proc->hp_ctx);
+            cpu->hc_proc->hp_running = 0;
+            break;
+        case CPU_TRAP:
+            break;
+    }
+
+    // the kernel handlers always leave with LDST, WAIT or HALT
+    exceptionHandler();
+    PANIC();
+    return NULL;
+}
+
+void LDST(state_t *statep) {
+    hostcpu_t *cpu = _self();
+
+    cpu->hc_loaded = *statep;
+    longjmp(cpu->hc_kernel, CPU_RUN);
+}
+
+/* Host monotonic clock in nanoseconds */
+static unsigned long long _hostNs(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void hostSendIpi(unsigned int word) {
+    for (int i = 0; i < NCPU; i++) {
+        if (word & (1U << (i + IPI_RECIPIENTS_SHIFT))) {
+            pthread_mutex_lock(&Cpus[i].hc_mutex);
+            Cpus[i].hc_ipi = 1;
+            pthread_cond_signal(&Cpus[i].hc_wakeup);
+            pthread_mutex_unlock(&Cpus[i].hc_mutex);
+        }
+    }
+}
+
+void WAIT(void) {
+    hostcpu_t      *cpu = _self();
+    struct timespec deadline;
+    unsigned int    cause;
+    unsigned long long queuedSince = 0; /* host time the own ready queue was first seen not empty, 0 if it is empty */
+
+    while (!(cause = _pendingInterrupt(cpu, 1))) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += WAIT_TIMEOUT_NS;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        pthread_mutex_lock(&cpu->hc_mutex);
+        if (!cpu->hc_ipi) pthread_cond_timedwait(&cpu->hc_wakeup, &cpu->hc_mutex, &deadline);
+        pthread_mutex_unlock(&cpu->hc_mutex);
+
+        // readyInsert wakes the home CPU of a process when it is idle: its queue cannot stay full while it waits
+        if (ReadyQueue[getPRID()].rq_count == 0) {
+            queuedSince = 0;
+        } else if (!queuedSince) {
+            queuedSince = _hostNs();
+        } else if (_hostNs() - queuedSince >= LOST_WAKEUP_NS) {
+            fprintf(stderr, "machine: CPU %d idle in WAIT with %d ready processes: lost wakeup\n", getPRID(), ReadyQueue[getPRID()].rq_count);
+            exit(2);
+        }
+    }
+
+    GET_EXCEPTION_STATE_PTR(getPRID())->cause = cause;
+    cpu->hc_cause = cause;
+    cpu->hc_status &= ~MSTATUS_MIE_MASK;
+    longjmp(cpu->hc_kernel, CPU_TRAP);
+}
+
+void HALT(void) {
+    pthread_mutex_lock(&HaltMutex);
+    Halted = 1;
+    pthread_cond_signal(&HaltCond);
+    pthread_mutex_unlock(&HaltMutex);
+    pthread_exit(NULL);
+}
+
+void INITCPU(unsigned int cpuid, state_t *start_state) {
+    Cpus[cpuid].hc_start = (void (*)(void))(uintptr_t)start_state->pc_epc;
+    pthread_create(&Cpus[cpuid].hc_thread, NULL, _cpuMain, &Cpus[cpuid]);
+}
+
+void LDCXT(unsigned int stackPtr, unsigned int status, unsigned int pc) {
+    fprintf(stderr, "machine: the support level is not simulated\n");
+    PANIC();
+}
+
+unsigned int getCAUSE(void) {
+    return _self()->hc_cause;
+}
+
+unsigned int getSTATUS(void) {
+    return _self()->hc_status;
+}
+
+void setSTATUS(unsigned int status) {
+    _self()->hc_status = status;
+}
+
+unsigned int getMIE(void) {
+    return _self()->hc_mie;
+}
+
+void setMIE(unsigned int mie) {
+    _self()->hc_mie = mie;
+}
+
+unsigned int getTIMER(void) {
+    return _self()->hc_timer - hostTOD();
+}
+
+void setTIMER(unsigned int timer) {
+    hostcpu_t *cpu = _self();
+
+    cpu->hc_timerParked = (timer == TIMER_PARKED);
+    cpu->hc_timer       = hostTOD() + timer;
+}
+
+/* no TLB: the host build has no virtual memory */
+void setENTRYHI(unsigned int entryHi) {
+    PANIC();
+}
+
+void setENTRYLO(unsigned int entryLo) {
+    PANIC();
+}
+
+void TLBWR(void) {
+    PANIC();
+}
+
+void TLBCLR(void) {
+}
+
+/* Adds c to the output line of a terminal or printer, printing the line when it ends */
+static void _devOutput(int line, int dev, char c) {
+    hostline_t *out = &DevOutput[line - 3][dev];
+
+    if (c != '\n' && out->len < LINEBUF - 1) {
+        out->buf[out->len++] = c;
+        return;
+    }
+    out->buf[out->len] = EOS;
+    printf("[%s%d] %s\n", line == TERMLINE ? "term" : "printer", dev, out->buf);
+    fflush(stdout);
+    out->len = 0;
+}
+
+/*
+    Moves a device through a command: a new command completes at once and
+    raises the interrupt, the ACK of the kernel lowers it. cmd is the command
+    register, status the status register that gets the result.
+    The kernel may write the next command before the bus cycle sees the ACK:
+    any command after a completion acknowledges it, and a new one is started
+    at the next cycle.
+*/
+static void _devCycle(int line, int dev, unsigned int cmd, unsigned int status, char c, unsigned int done) {
+    volatile int *pending = &DevPending[line - 3][dev];
+    unsigned int  bit     = 1U << dev;
+
+    if (!*pending && (REG(cmd) & 0xFF) == PRINTCHR) {
+        _devOutput(line, dev, c);
+        // the command is cleared first: a kernel polling the status may ACK as soon as it reads done
+        REG(cmd)    = RESET;
+        REG(status) = done;
+        *pending    = 1;
+        __atomic_fetch_or((unsigned int *)(uintptr_t)(INTDEVBITMAP + (line - 3) * WORDLEN), bit, __ATOMIC_ACQ_REL);
+        _wakeAll();
+    } else if (*pending && REG(cmd) != RESET) {
+        if (REG(cmd) == ACK) REG(cmd) = RESET;
+        REG(status) = READY;
+        *pending    = 0;
+        __atomic_fetch_and((unsigned int *)(uintptr_t)(INTDEVBITMAP + (line - 3) * WORDLEN), ~bit, __ATOMIC_ACQ_REL);
+        __atomic_fetch_and(&LinesClaimed, ~(1U << line), __ATOMIC_ACQ_REL);
+    }
+}
+
+/* The hardware of the machine: TOD, interval timer, IPIs and devices */
+static void *_busMain(void *arg) {
+    struct timespec period = {0, BUS_PERIOD_NS};
+    unsigned int    timerLast = TIMER_PARKED, timerDeadline = 0;
+    int             timerParked = 1;
+
+    for (;;) {
+        unsigned int now = hostTOD();
+        REG(TODLOADDR)   = now;
+
+        // a value different from the last one written here was loaded by the kernel
+        unsigned int timer = REG(INTERVALTMR);
+        if (timer != timerLast) {
+            timerParked   = (timer == TIMER_PARKED);
+            timerDeadline = now + timer;
+            TimerPending  = 0;
+            __atomic_fetch_and(&LinesClaimed, ~(1U << 2), __ATOMIC_ACQ_REL);
+        }
+        if (!timerParked) {
+            unsigned int left = TOD_BEFORE(now, timerDeadline) ? timerDeadline - now : 0;
+            if (__atomic_compare_exchange_n((unsigned int *)(uintptr_t)INTERVALTMR, &timer, left, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                timerLast = left;
+                if (!left && !TimerPending) {
+                    TimerPending = 1;
+                    _wakeAll();
+                }
+            }
+            // otherwise the kernel loaded it meanwhile: timerLast differs, seen at the next cycle
+        } else {
+            timerLast = timer;
+        }
+
+        for (int dev = 0; dev < DEVPERINT; dev++) {
+            unsigned int term = DEVBASE(TERMLINE, dev), printer = DEVBASE(PRINTERLINE, dev);
+            _devCycle(TERMLINE, dev, term + 0xC, term + 0x8, REG(term + 0xC) >> 8, (REG(term + 0xC) & 0xFF00) | TRANSMITTED);
+            _devCycle(PRINTERLINE, dev, printer + 0x4, printer, REG(printer + 0x8), READY);
+        }
+
+        nanosleep(&period, NULL);
+    }
+    return NULL;
+}
+
+/* Maps the BIOS data page, the bus registers and the RAM at their uriscv addresses */
+static void _mapMemory(void) {
+    struct {
+        uintptr_t addr;
+        size_t    size;
+    } areas[] = {{BIOSDATAPAGE, PAGESIZE}, {BUSPAGE, PAGESIZE}, {RAMSTART, RAMSIZE}};
+
+    for (int i = 0; i < 3; i++) {
+        void *p = mmap((void *)areas[i].addr, areas[i].size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+        if (p != (void *)areas[i].addr) {
+            fprintf(stderr, "machine: cannot map 0x%08lx\n", (unsigned long)areas[i].addr);
+            exit(1);
+        }
+    }
+
+    REG(RAMBASEADDR)   = RAMSTART;
+    REG(RAMBASESIZE)   = RAMSIZE;
+    REG(TIMESCALEADDR) = 1;
+    REG(INTERVALTMR)   = TIMER_PARKED;
+    for (int dev = 0; dev < DEVPERINT; dev++) {
+        REG(DEVBASE(TERMLINE, dev) + 0x8) = READY;
+        REG(DEVBASE(PRINTERLINE, dev))    = READY;
+    }
+}
+
+static void _boot(void) {
+    kernelMain();
+}
+
+int main(void) {
+    pthread_t       bus;
+    struct timespec start, end;
+
+    _mapMemory();
+    for (int i = 0; i < NCPU; i++) {
+        pthread_mutex_init(&Cpus[i].hc_mutex, NULL);
+        pthread_cond_init(&Cpus[i].hc_wakeup, NULL);
+        Cpus[i].hc_timerParked = 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_create(&bus, NULL, _busMain, NULL);
+    Cpus[0].hc_start = _boot;
+    pthread_create(&Cpus[0].hc_thread, NULL, _cpuMain, &Cpus[0]);
+
+    pthread_mutex_lock(&HaltMutex);
+    while (!Halted)
+        pthread_cond_wait(&HaltCond, &HaltMutex);
+    pthread_mutex_unlock(&HaltMutex);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("machine: HALT after %.1f ms\n", (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6);
+    return 0;
+}
@@ -0,0 +1,216 @@
+/*********************************P2STRESS.C*****************************
+ *
+ *	Stress test and benchmark of phase 2 on the simulated host machine.
+ *
+ *	test() is the first process, as for p2test on uriscv. It measures the
+ *	round trip of the non blocking syscalls (the read-only ones and
+ *	SETAFFINITY, which changes the caller), a semaphore ping-pong between two
+ *	processes, the same ping-pong between two processes pinned to two
+ *	different CPUs (every V has to wake an idle CPU with an IPI: a lost one
+ *	leaves it in WAIT, which the machine reports), YIELD and a counter
+ *	incremented under a semaphore by
+ *	WORKERS processes spread over all the CPUs (with hostPoll inside the
+ *	critical section, so the time slices expire while the mutex is held).
+ *	It then creates and terminates ROUNDS process trees, many more than
+ *	MAXPROC, checks that a DOIO on an address that is not a device command
+ *	terminates its caller, waits for the pseudo clock and prints on terminal 0
+ *	through DOIO. Every result is checked: a wrong one PANICs, and the machine
+ *	HALTs when the last process terminates.
+ */
+
+#include "../headers/const.h"
+#include "../headers/types.h"
+
+#include <uriscv/liburiscv.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define SYSCALLS  200000
+#define PINGPONGS 20000
+#define WAKEUPS   2000
+#define YIELDS    20000
+#define WORKERS   6
+#define INCREMENTS 2000
+#define ROUNDS    200
+#define CHILDREN  3
+
+#define TERM0ADDR 0x10000254
+
+int ping, pong;
+int wake, woken;
+int mutex = 1, done, counter;
+int spawned, forever;
+
+state_t ponger_s, pinned_s, worker_s, spawner_s, sleeper_s, badio_s;
+
+/* This function returns the host monotonic clock in nanoseconds */
+static unsigned long long now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void report(const char *name, unsigned long long ns, unsigned long ops) {
+    printf("p2stress: %-28s %10.1f ns/op\n", name, (double)ns / ops);
+}
+
+/* a state for a new kernel-mode process with interrupts on, reg_tp 0 (see machine.c) */
+static void newState(state_t *s, void (*entry)(void)) {
+    memset(s, 0, sizeof(*s));
+    s->pc_epc = (memaddr)entry;
+    s->status = MSTATUS_MPIE_MASK | MSTATUS_MPP_M;
+    s->mie    = MIE_ALL;
+}
+
+/* times SYSCALLS calls of a non blocking syscall, checking that they all return expect */
+static void roundTrip(const char *name, int number, int arg, int expect) {
+    unsigned long long start = now();
+
+    for (int i = 0; i < SYSCALLS; i++) {
+        if ((int)SYSCALL(number, arg, 0, 0) != expect) PANIC();
+    }
+    report(name, now() - start, SYSCALLS);
+}
+
+static int create(state_t *s) {
+    int pid = SYSCALL(CREATEPROCESS, (int)s, PROCESS_PRIO_LOW, 0);
+
+    if (pid < 0) PANIC();
+    return pid;
+}
+
+/* prints str on terminal 0, one DOIO per character */
+static void termprint(char *str) {
+    termreg_t *term = (termreg_t *)TERM0ADDR;
+
+    for (; *str != EOS; str++) {
+        unsigned int status = SYSCALL(DOIO, (int)&term->transm_command, PRINTCHR | (*str << 8), 0);
+        if ((status & 0xFF) != RECVD) PANIC();
+    }
+}
+
+void ponger(void) {
+    for (int i = 0; i < PINGPONGS; i++) {
+        SYSCALL(PASSEREN, (int)&ping, 0, 0);
+        SYSCALL(VERHOGEN, (int)&pong, 0, 0);
+    }
+    SYSCALL(TERMPROCESS, 0, 0, 0);
+}
+
+/* the other end of the wakeup ping-pong, on the last CPU only */
+void pinned(void) {
+    SYSCALL(SETAFFINITY, 1U << (NCPU - 1), 0, 0);
+    for (int i = 0; i < WAKEUPS; i++) {
+        SYSCALL(PASSEREN, (int)&wake, 0, 0);
+        SYSCALL(VERHOGEN, (int)&woken, 0, 0);
+    }
+    SYSCALL(TERMPROCESS, 0, 0, 0);
+}
+
+void worker(void) {
+    for (int i = 0; i < INCREMENTS; i++) {
+        SYSCALL(PASSEREN, (int)&mutex, 0, 0);
+        int seen = counter;
+        hostPoll();
+        counter = seen + 1;
+        SYSCALL(VERHOGEN, (int)&mutex, 0, 0);
+    }
+    SYSCALL(VERHOGEN, (int)&done, 0, 0);
+    SYSCALL(TERMPROCESS, 0, 0, 0);
+}
+
+void sleeper(void) {
+    SYSCALL(PASSEREN, (int)&forever, 0, 0);
+    PANIC();
+}
+
+/* a DOIO on the status register of terminal 0 must terminate the caller */
+void badio(void) {
+    SYSCALL(DOIO, TERM0ADDR, PRINTCHR, 0);
+    PANIC();
+}
+
+void spawner(void) {
+    for (int i = 0; i < CHILDREN; i++)
+        create(&sleeper_s);
+    SYSCALL(VERHOGEN, (int)&spawned, 0, 0);
+    SYSCALL(PASSEREN, (int)&forever, 0, 0);
+    PANIC();
+}
+
+void test(void) {
+    unsigned long long start;
+    int                i, pid = SYSCALL(GETPROCESSID, 0, 0, 0);
+
+    newState(&ponger_s, ponger);
+    newState(&pinned_s, pinned);
+    newState(&worker_s, worker);
+    newState(&spawner_s, spawner);
+    newState(&sleeper_s, sleeper);
+    newState(&badio_s, badio);
+
+    roundTrip("GETPROCESSID round trip", GETPROCESSID, 0, pid);
+    roundTrip("GETPROCESSID(parent)", GETPROCESSID, 1, 0);
+    roundTrip("GETSUPPORTPTR round trip", GETSUPPORTPTR, 0, 0);
+    roundTrip("SETAFFINITY round trip", SETAFFINITY, 0, ALLCPUS_MASK);
+
+    start = now();
+    for (i = 0; i < SYSCALLS; i++) {
+        if ((int)SYSCALL(GETTIME, 0, 0, 0) < 0) PANIC();
+    }
+    report("GETTIME round trip", now() - start, SYSCALLS);
+
+    create(&ponger_s);
+    start = now();
+    for (i = 0; i < PINGPONGS; i++) {
+        SYSCALL(VERHOGEN, (int)&ping, 0, 0);
+        SYSCALL(PASSEREN, (int)&pong, 0, 0);
+    }
+    report("P/V ping-pong round trip", now() - start, PINGPONGS);
+
+    // this process stays on CPU 0: each side blocks and leaves its CPU idle
+    SYSCALL(SETAFFINITY, 1, 0, 0);
+    create(&pinned_s);
+    start = now();
+    for (i = 0; i < WAKEUPS; i++) {
+        SYSCALL(VERHOGEN, (int)&wake, 0, 0);
+        SYSCALL(PASSEREN, (int)&woken, 0, 0);
+    }
+    report("P/V between idle CPUs", now() - start, WAKEUPS);
+    SYSCALL(SETAFFINITY, 0, 0, 0);
+
+    start = now();
+    for (i = 0; i < YIELDS; i++)
+        SYSCALL(YIELD, 0, 0, 0);
+    report("YIELD", now() - start, YIELDS);
+
+    start = now();
+    for (i = 0; i < WORKERS; i++)
+        create(&worker_s);
+    for (i = 0; i < WORKERS; i++)
+        SYSCALL(PASSEREN, (int)&done, 0, 0);
+    if (counter != WORKERS * INCREMENTS) PANIC();
+    report("mutex increment", now() - start, WORKERS * INCREMENTS);
+
+    start = now();
+    for (i = 0; i < ROUNDS; i++) {
+        int child = create(&spawner_s);
+        SYSCALL(PASSEREN, (int)&spawned, 0, 0);
+        SYSCALL(TERMPROCESS, child, 0, 0);
+    }
+    report("create + terminate tree", now() - start, ROUNDS * (CHILDREN + 1));
+
+    // the machine HALTs only once it is terminated, so a DOIO that returns PANICs
+    create(&badio_s);
+
+    unsigned int before = SYSCALL(GETTIME, 0, 0, 0);
+    SYSCALL(CLOCKWAIT, 0, 0, 0);
+    SYSCALL(CLOCKWAIT, 0, 0, 0);
+    if (SYSCALL(GETTIME, 0, 0, 0) < before) PANIC();
+
+    termprint("p2stress: all checks passed\n");
+    SYSCALL(TERMPROCESS, 0, 0, 0);
+}
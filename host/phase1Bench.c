@@ -0,0 +1,149 @@
+/*********************************PHASE1BENCH.C**************************
+ *
+ *	Host benchmark of the phase 1 data structures.
+ *
+ *	Built by host/CMakeLists.txt once for every pool size (MAXPROC), it
+ *	measures with the host clock the throughput of allocPcb/freePcb,
+ *	insertBlocked/removeBlocked on MAXPROC distinct semaphores,
+ *	outBlockedPID with four processes per semaphore and the walks of a
+ *	process queue holding the whole pool (a pid scan and outProcQ of the
+ *	tail), and prints one line per operation: nanoseconds per operation
+ *	and millions of operations per second. The walks are reported per PCB
+ *	visited, so they show how many cache lines the layout of pcb_t costs.
+ *	Every result is checked, a wrong one PANICs.
+ */
+
+#include "../headers/const.h"
+#include "../headers/types.h"
+
+#include <uriscv/liburiscv.h>
+#include "../phase1/headers/pcb.h"
+#include "../phase1/headers/asl.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#ifndef BENCH_OPS
+#define BENCH_OPS (1 << 22) /* operations per measure, outBlockedPID does BENCH_OPS / 64 */
+#endif
+#define SEMAPHORES (MAXPROC / 4 > 0 ? MAXPROC / 4 : 1)
+#define STRIDE     7 /* coprime with the pool sizes: the queue does not follow the pool in memory */
+
+int              sem[MAXPROC];
+pcb_t           *procp[MAXPROC];
+struct list_head queue;
+
+/* This function returns the host monotonic clock in nanoseconds */
+static unsigned long long now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* This function prints a result line: nanoseconds per operation and throughput */
+static void report(const char *name, unsigned long long ns, unsigned long ops) {
+    printf("MAXPROC %5d  %-30s %8.1f ns/op %8.2f Mops/s\n", MAXPROC, name, (double)ns / ops, ops * 1000.0 / ns);
+}
+
+/* This function walks the queue comparing the pids, returns the process with the given pid */
+static pcb_t *scanByPid(struct list_head *head, int pid) {
+    struct list_head *iter;
+
+    list_for_each(iter, head) {
+        pcb_t *p = container_of(iter, pcb_t, p_list);
+        if (p->p_pid == pid)
+            return p;
+    }
+    return NULL;
+}
+
+int main(void) {
+    unsigned long      rounds = BENCH_OPS / MAXPROC > 0 ? BENCH_OPS / MAXPROC : 1;
+    unsigned long      r, ops;
+    unsigned long long start;
+    int                i;
+    pcb_t             *p;
+
+    initPcbs();
+    initASL();
+
+    /* the whole pool allocated and given back, through the per-CPU cache and the global pool */
+    start = now();
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < MAXPROC; i++) {
+            if ((procp[i] = allocPcb()) == NULL)
+                PANIC();
+        }
+        for (i = 0; i < MAXPROC; i++)
+            freePcb(procp[i]);
+    }
+    report("allocPcb + freePcb", now() - start, rounds * MAXPROC);
+
+    for (i = 0; i < MAXPROC; i++) {
+        if ((procp[i] = allocPcb()) == NULL)
+            PANIC();
+    }
+
+    /* every process moves to the next semaphore: the semds are freed and reallocated */
+    for (i = 0; i < MAXPROC; i++) {
+        if (insertBlocked(&sem[i], procp[i]))
+            PANIC();
+    }
+    start = now();
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < MAXPROC; i++) {
+            if ((p = removeBlocked(&sem[(i + r) % MAXPROC])) == NULL)
+                PANIC();
+            insertBlocked(&sem[(i + r + 1) % MAXPROC], p);
+        }
+    }
+    report("removeBlocked + insertBlocked", now() - start, rounds * MAXPROC);
+    for (i = 0; i < MAXPROC; i++) {
+        if (outBlocked(procp[i]) != procp[i])
+            PANIC();
+    }
+
+    /* outBlockedPID of pids spread over the whole ASL */
+    for (i = 0; i < MAXPROC; i++)
+        insertBlocked(&sem[i % SEMAPHORES], procp[i]);
+    ops   = BENCH_OPS / 64 > 0 ? BENCH_OPS / 64 : 1;
+    start = now();
+    for (r = 0; r < ops; r++) {
+        p        = procp[(r * 7) % MAXPROC];
+        int *key = p->p_semAdd;
+        if (outBlockedPID(p->p_pid) != p)
+            PANIC();
+        insertBlocked(key, p);
+    }
+    report("outBlockedPID + insertBlocked", now() - start, ops);
+    for (i = 0; i < MAXPROC; i++) {
+        if (outBlocked(procp[i]) != procp[i])
+            PANIC();
+    }
+
+    /* the whole pool in one queue, in an order that jumps around the pool */
+    mkEmptyProcQ(&queue);
+    for (i = 0; i < MAXPROC; i++)
+        insertProcQ(&queue, procp[(i * STRIDE) % MAXPROC]);
+
+    /* pid scan of the last process: the whole queue is walked */
+    p     = procp[((MAXPROC - 1) * STRIDE) % MAXPROC];
+    start = now();
+    for (r = 0; r < rounds; r++) {
+        if (scanByPid(&queue, p->p_pid) != p)
+            PANIC();
+    }
+    report("pid scan (per PCB)", now() - start, rounds * MAXPROC);
+
+    /* outProcQ of the tail, put back at the tail: the whole queue is walked */
+    start = now();
+    for (r = 0; r < rounds; r++) {
+        if (outProcQ(&queue, p) != p)
+            PANIC();
+        insertProcQ(&queue, p);
+    }
+    report("outProcQ tail (per PCB)", now() - start, rounds * MAXPROC);
+
+    return 0;
+}
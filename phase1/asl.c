@@ -1,54 +1,96 @@
 #include "./headers/asl.h"
 #include "./headers/pcb.h"
+#include "./headers/slab.h"
 
-
+/*
+    The ASL is a hash table keyed by semaphore address: every bucket is a
+    doubly linked list of the active semds whose key hashes to it, so that
+    finding, adding and removing a semd only touch one (short) bucket.
+*/
+#define ASL_HASH_SIZE (1 << ASL_HASH_BITS)
 
 static semd_t semd_table[MAXPROC];
 static struct list_head semdFree_h;
-static struct list_head semd_h;
+static struct list_head semd_hash[ASL_HASH_SIZE];
+
+#if DYNAMIC_POOLS
+// semds beyond the MAXPROC static ones, see slab.c
+static slabcache_t SemdCache;
+
+static inline int isStaticSem(semd_t* sem) {
+    return sem >= semd_table && sem < semd_table + MAXPROC;
+}
+#endif
+
 
+// Fibonacci hashing: neighbouring addresses (like the device semaphores) end up far apart
+static inline struct list_head* bucketOf(int* key) {
+    unsigned int word = (unsigned int)((unsigned long)key >> 2);
+    return &semd_hash[(word * 2654435761U) >> (32 - ASL_HASH_BITS)];
+}
 
+// NULL when there are no more semd_t available
 static inline semd_t* allocSem(int* key) {
-    semd_t* newSem = container_of(semdFree_h.prev, semd_t, s_link); 
-    list_del(&newSem->s_link); 
+    semd_t* newSem;
+    if (!list_empty(&semdFree_h)) {
+        newSem = container_of(semdFree_h.prev, semd_t, s_link); 
+        list_del(&newSem->s_link); 
+    } else {
+#if DYNAMIC_POOLS
+        newSem = slabAlloc(&SemdCache);
+        if (newSem == NULL) return NULL;
+#else
+        return NULL;
+#endif
+    }
     newSem->s_key = key; 
     mkEmptyProcQ(&newSem->s_procq); 
     return newSem;
 }
 
+// give the semd back to the free list once nobody is blocked on it
+static inline void freeSemIfEmpty(semd_t* sem) {
+    if (emptyProcQ(&sem->s_procq)) {
+        list_del(&sem->s_link);
+#if DYNAMIC_POOLS
+        if (!isStaticSem(sem)) {
+            slabFree(&SemdCache, sem);
+            return;
+        }
+#endif
+        list_add_tail(&sem->s_link, &semdFree_h);
+    }
+}
+
 static inline semd_t* findSemd(int* key) {
-    struct list_head *iter = semd_h.next;
-    while (iter != NULL && !list_empty(&semd_h)) {
+    struct list_head* bucket = bucketOf(key);
+    struct list_head* iter;
+    list_for_each(iter, bucket) {
         semd_t* iterSem = container_of(iter, semd_t, s_link);
         if (iterSem->s_key == key) {
             return iterSem;
         }
-        iter = iter->next;
     }
     return NULL;
 }
 
-void insertSem(int* key, pcb_t* p) {
-  semd_t* newSem = allocSem(key);
-  list_add_tail(&p->p_list, &newSem->s_procq);
-  semd_t* iter = container_of(semd_h.next, semd_t, s_link);
-  if (semd_h.next == NULL) { // if the semd_h is empty, add the new semd to the head. Making the semd_h a single linked list
-        semd_h.next = &newSem->s_link;
-        newSem->s_link.next = NULL;
-  } else { 
-    semd_t* iter = container_of(semd_h.next, semd_t, s_link);
-    while (iter->s_link.next != NULL){
-      iter = container_of(iter->s_link.next, semd_t, s_link); 
-    }
-    iter->s_link.next = &newSem->s_link;
-    newSem->s_link.next = NULL;
-  }
+int insertSem(int* key, pcb_t* p) {
+    semd_t* newSem = allocSem(key);
+    if (newSem == NULL) return 1;
+
+    list_add_tail(&p->p_list, &newSem->s_procq);
+    list_add(&newSem->s_link, bucketOf(key));
+    return 0;
 }
 
 void initASL() {
+#if DYNAMIC_POOLS
+    slabCacheInit(&SemdCache, sizeof(semd_t), NULL);
+#endif
     INIT_LIST_HEAD(&semdFree_h);
-    semd_h.next=NULL;
-    //INIT_LIST_HEAD(&semd_h);
+    for (int i = 0; i < ASL_HASH_SIZE; i++) {
+        INIT_LIST_HEAD(&semd_hash[i]);
+    }
     
     for (int i = 0; i < MAXPROC; i++) {
         INIT_LIST_HEAD(&semd_table[i].s_link);
@@ -60,15 +102,11 @@ int insertBlocked(int* semAdd, pcb_t* p) {
     semd_t* sem = findSemd(semAdd);
     if (sem) { //if the semd already exists, add the process to the end of its process queue
         list_add_tail(&p->p_list, &sem->s_procq);
-    } else {
-        if (list_empty(&semdFree_h)) { //if there are no more semd_t available, return 1
-            return 1;
-        }
-        insertSem(semAdd, p); //insert the new semd in the right place
-        //semd_t* newSem = allocSem(semAdd);
-        //list_add_tail(&p->p_list, &newSem->s_procq); //add the process to the end of the new semd's process queue
+    } else if (insertSem(semAdd, p)) { //add a new semd to the bucket of semAdd
+        return 1; //if there are no more semd_t available, return 1
     }
     p->p_semAdd = semAdd;
+    p->p_state = PCB_BLOCKED;
     return 0;
 }
 
@@ -76,16 +114,8 @@ pcb_t* removeBlocked(int* semAdd) {
     semd_t* sem = findSemd(semAdd);
     if (sem) { 
         pcb_t *head = removeProcQ(&sem->s_procq);
-        if (emptyProcQ(&sem->s_procq)) {
-            struct list_head* prev = &semd_h;
-
-            while (prev->next != &sem->s_link) { //find the previous semd_t needed to remove the semd_t from the list
-                prev = prev->next;
-            }
-            prev->next = sem->s_link.next; //remove the semd_t from the list
-            sem->s_link.next = NULL;
-            list_add_tail(&sem->s_link, &semdFree_h); //insert sem into semdFree_h
-        }
+        head->p_semAdd = NULL;
+        freeSemIfEmpty(sem);
         return head;
     }
     return NULL;
@@ -95,7 +125,12 @@ pcb_t* outBlocked(pcb_t* p) {
     semd_t* sem = findSemd(p->p_semAdd);
     if (sem == NULL) return NULL;
 
-    return outProcQ(&sem->s_procq, p);
+    // p_semAdd is only set while p is in the queue of its semd, and p_list is
+    // doubly linked: p can be unlinked without looking for it
+    list_del(&p->p_list);
+    p->p_semAdd = NULL;
+    freeSemIfEmpty(sem);
+    return p;
 }
 
 pcb_t* headBlocked(int* semAdd) {
@@ -110,20 +145,23 @@ pcb_t* headBlocked(int* semAdd) {
     return headProcQ(&sem->s_procq);
 }
 
-// FIX: devo iterare su semdh e per ogni semaforo cerca il processo bloccato che ha quel pid
+// iterates on every bucket and, for each semaphore, looks for the blocked process with that pid
 pcb_t* outBlockedPID(int pid) {
-  struct list_head* iterSem;
-  list_for_each(iterSem, &semd_h) {
-    semd_t* sem = container_of(iterSem, semd_t, s_link);
-    struct list_head* iterProc;
-    list_for_each(iterProc, &sem->s_procq) {
-      pcb_t* proc = container_of(iterProc, pcb_t, p_list);
-      if (proc->p_pid == pid) {
-        list_del(&proc->p_list);
-        return proc;
+  for (int i = 0; i < ASL_HASH_SIZE; i++) {
+    struct list_head* iterSem;
+    list_for_each(iterSem, &semd_hash[i]) {
+      semd_t* sem = container_of(iterSem, semd_t, s_link);
+      struct list_head* iterProc;
+      list_for_each(iterProc, &sem->s_procq) {
+        pcb_t* proc = container_of(iterProc, pcb_t, p_list);
+        if (proc->p_pid == pid) {
+          list_del(&proc->p_list);
+          proc->p_semAdd = NULL;
+          freeSemIfEmpty(sem);
+          return proc;
+        }
       }
     }
   }
   return NULL;
 }
-
@@ -0,0 +1,136 @@
+/*********************************ASLBENCH.C*****************************
+ *
+ *	Microbenchmark of the ASL (phase 1) with many distinct semaphores.
+ *
+ *	Blocks MAXPROC processes on MAXPROC different semaphores, then moves
+ *	them around with insertBlocked/removeBlocked/headBlocked/outBlocked
+ *	and prints on terminal 0 the TOD ticks spent by each kind of operation.
+ *	Build it with a large MAXPROC (MULOS_BENCH in CMakeLists.txt uses 512)
+ *	to see how the operations scale with the number of active semaphores.
+ */
+
+#include "../headers/const.h"
+#include "../headers/types.h"
+
+#include <uriscv/liburiscv.h>
+#include "./headers/pcb.h"
+#include "./headers/asl.h"
+
+#define ROUNDS 8
+
+#define TRANSMITTED 5
+#define CHAROFFSET  8
+#define STATUSMASK  0xFF
+#define TERM0ADDR   0x10000254
+
+typedef unsigned int devreg;
+
+int    sem[MAXPROC];
+pcb_t *procp[MAXPROC];
+
+/* This function prints a string on terminal 0, busy waiting on every character */
+void termprint(char *str) {
+    devreg *statusp  = (devreg *)(TERM0ADDR + (TRANSTATUS * DEVREGLEN));
+    devreg *commandp = (devreg *)(TERM0ADDR + (TRANCOMMAND * DEVREGLEN));
+
+    while (*str != EOS) {
+        *commandp = (*str << CHAROFFSET) | PRINTCHR;
+        while (((*statusp) & STATUSMASK) == BUSY)
+            ;
+        if (((*statusp) & STATUSMASK) != TRANSMITTED)
+            PANIC();
+        str++;
+    }
+}
+
+/* This function prints num in decimal on terminal 0 */
+void termprintnum(unsigned int num) {
+    char buf[11];
+    int  i = 10;
+
+    buf[i] = EOS;
+    do {
+        buf[--i] = '0' + num % 10;
+        num /= 10;
+    } while (num > 0);
+    termprint(&buf[i]);
+}
+
+/* This function prints a result line: total ticks and ticks per operation */
+void report(char *name, unsigned int ticks, unsigned int ops) {
+    termprint(name);
+    termprint(": ");
+    termprintnum(ticks);
+    termprint(" ticks, ");
+    termprintnum(ticks / ops);
+    termprint(" per op\n");
+}
+
+
+int main(void) {
+    int          i, r;
+    cpu_t        start, end;
+    unsigned int ops = ROUNDS * MAXPROC;
+    pcb_t       *p;
+
+    initPcbs();
+    initASL();
+    for (i = 0; i < MAXPROC; i++) {
+        procp[i] = allocPcb();
+        if (procp[i] == NULL)
+            PANIC();
+    }
+
+    termprint("ASL benchmark, semaphores: ");
+    termprintnum(MAXPROC);
+    termprint("\n");
+
+    /* a new semd for every insertion, one per semaphore */
+    STCK(start);
+    for (i = 0; i < MAXPROC; i++) {
+        if (insertBlocked(&sem[i], procp[i]))
+            PANIC();
+    }
+    STCK(end);
+    report("insertBlocked (new semd)", end - start, MAXPROC);
+
+    /* lookups of semaphores spread over the whole ASL */
+    STCK(start);
+    for (r = 0; r < ROUNDS; r++) {
+        for (i = 0; i < MAXPROC; i++) {
+            if (headBlocked(&sem[i]) != procp[i])
+                PANIC();
+        }
+    }
+    STCK(end);
+    report("headBlocked", end - start, ops);
+
+    /* every process moves to the next semaphore: the semds are freed and reallocated */
+    STCK(start);
+    for (r = 0; r < ROUNDS; r++) {
+        for (i = 0; i < MAXPROC; i++) {
+            p = removeBlocked(&sem[i]);
+            insertBlocked(&sem[(i + 1) % MAXPROC], p);
+        }
+    }
+    STCK(end);
+    report("removeBlocked + insertBlocked", end - start, ops);
+
+    /* outBlocked from the tail and back */
+    STCK(start);
+    for (r = 0; r < ROUNDS; r++) {
+        for (i = 0; i < MAXPROC; i++) {
+            p = procp[i];
+            int *key = p->p_semAdd;
+            if (outBlocked(p) != p)
+                PANIC();
+            insertBlocked(key, p);
+        }
+    }
+    STCK(end);
+    report("outBlocked + insertBlocked", end - start, ops);
+
+    termprint("ASL benchmark done\n");
+    HALT();
+    return 0;
+}
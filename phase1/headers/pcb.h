@@ -7,6 +7,7 @@
 void initPcbs();
 void freePcb(pcb_t* p);
 pcb_t* allocPcb();
+pcb_t* pidLookup(int pid);
 void mkEmptyProcQ(struct list_head* head);
 int emptyProcQ(struct list_head* head);
 void insertProcQ(struct list_head* head, pcb_t* p);
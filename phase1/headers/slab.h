@@ -0,0 +1,18 @@
+#ifndef SLAB_H_INCLUDED
+#define SLAB_H_INCLUDED
+
+#include "../../headers/listx.h"
+#include "../../headers/types.h"
+
+/* objects that fit in a slab after its header */
+#define SLAB_OBJS(size) ((PAGESIZE - sizeof(slab_t)) / (size))
+
+void slabCacheInit(slabcache_t* cache, unsigned int objSize, void (*ctor)(void* obj, int index));
+void* slabAlloc(slabcache_t* cache);
+void slabFree(slabcache_t* cache, void* obj);
+int slabOwns(slabcache_t* cache, void* obj);
+int slabIndexOf(slabcache_t* cache, void* obj);
+void* slabLookup(slabcache_t* cache, int index, int (*match)(void* obj, int key), int key);
+unsigned int slabFreeFrames(void);
+
+#endif
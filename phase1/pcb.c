@@ -1,11 +1,124 @@
 #include "./headers/pcb.h"
+#include "./headers/slab.h"
+
+#include <uriscv/liburiscv.h>
 
 #include "../headers/const.h"
 #include "../headers/listx.h"
 
-static struct list_head pcbFree_h;
+/*
+    Free PCBs: a small cache per CPU in front of a global pool. All of them
+    are lock-free stacks of indexes into pcbFree_table: the head is a word
+    (tag << 16 | index) updated with CAS, and the tag changes on every push
+    and pop. A CAS with a stale head fails unless the 16 bit tag went through
+    exactly 65536 changes in between, so ABA is very unlikely, though not
+    ruled out. Every CPU works on its own cache; the pool and the caches of
+    the other CPUs are only touched when its own is empty or full.
+*/
+#define PCB_NIL     0xFFFF
+#define STACK_INDEX 0x0000FFFF
+#define STACK_TAG   0x00010000
+
 static pcb_t pcbFree_table[MAXPROC];
-static int next_pid = 1;
+static state_t pcbState_table[MAXPROC];               /* cold area: saved states, p_s of the PCB with the same index */
+static volatile unsigned int pcbFree_next[MAXPROC]; /* index of the next PCB in the stack */
+static volatile unsigned int pcbFree_pool;
+static volatile unsigned int pcbFree_cache[NCPU];
+static int pcbFree_cacheCount[NCPU];                 /* only a hint: steals do not update it, an empty cache resets it */
+
+/*
+    With DYNAMIC_POOLS, once the MAXPROC static PCBs are all in use more are
+    allocated from slabs (see slab.c); they never enter the lock-free stacks.
+*/
+#if DYNAMIC_POOLS
+#define PID_SLOTS ((int)(MAXPROC + SLAB_MAXFRAMES * SLAB_OBJS(sizeof(pcb_t))))
+static slabcache_t PcbCache;
+static slabcache_t StateCache; /* cold area of the slab PCBs */
+#else
+#define PID_SLOTS MAXPROC
+#endif
+
+/*
+    PID index: the pid of a PCB is always congruent to its slot + 1 modulo
+    PID_SLOTS (it grows by PID_SLOTS every time the PCB is reused). The slot
+    of a static PCB is its position in pcbFree_table, that of a slab PCB is
+    MAXPROC + its slab index, so (pid - 1) % PID_SLOTS tells the only place
+    where a process with that pid can be. allocPcb and freePcb keep
+    pidTable up to date for the static PCBs.
+*/
+static pcb_t* pidTable[MAXPROC];
+
+static void _stackPush(volatile unsigned int* stack, pcb_t* p) {
+    unsigned int idx = p - pcbFree_table;
+    unsigned int old;
+
+    do {
+        old = *stack;
+        pcbFree_next[idx] = old & STACK_INDEX;
+    } while (!CAS((unsigned int*)stack, old, ((old & ~STACK_INDEX) + STACK_TAG) | idx));
+}
+
+static pcb_t* _stackPop(volatile unsigned int* stack) {
+    unsigned int old, idx;
+
+    do {
+        old = *stack;
+        idx = old & STACK_INDEX;
+        if (idx == PCB_NIL) return NULL;
+        // if another CPU already took idx the head has changed and the CAS fails
+    } while (!CAS((unsigned int*)stack, old, ((old & ~STACK_INDEX) + STACK_TAG) | pcbFree_next[idx]));
+
+    return &pcbFree_table[idx];
+}
+
+// takes a PCB from the global pool and moves PCB_CACHE_BATCH - 1 more into the cache of cpu
+static pcb_t* _refillCache(int cpu) {
+    pcb_t* pcb = _stackPop(&pcbFree_pool);
+    if (pcb == NULL) return NULL;
+
+    for (int i = 1; i < PCB_CACHE_BATCH; i++) {
+        pcb_t* extra = _stackPop(&pcbFree_pool);
+        if (extra == NULL) break;
+        _stackPush(&pcbFree_cache[cpu], extra);
+        pcbFree_cacheCount[cpu]++;
+    }
+    return pcb;
+}
+
+// empty pool: the free PCBs left can only be in the caches of the other CPUs
+static pcb_t* _stealPcb(int cpu) {
+    for (int i = 1; i < NCPU; i++) {
+        pcb_t* pcb = _stackPop(&pcbFree_cache[(cpu + i) % NCPU]);
+        if (pcb != NULL) return pcb;
+    }
+    return NULL;
+}
+
+static inline int _isStatic(pcb_t* pcb) {
+    return pcb >= pcbFree_table && pcb < pcbFree_table + MAXPROC;
+}
+
+static inline int _slotOf(pcb_t* pcb) {
+#if DYNAMIC_POOLS
+    if (!_isStatic(pcb)) return MAXPROC + slabIndexOf(&PcbCache, pcb);
+#endif
+    return pcb - pcbFree_table;
+}
+
+// only the CPU that took pcb from a free list touches it, so no atomics are needed
+static inline int _nextPid(pcb_t* pcb) {
+    int pid = pcb->p_pid + PID_SLOTS;
+    return pid > 0 ? pid : _slotOf(pcb) + 1; // wrapped around
+}
+
+#if DYNAMIC_POOLS
+// a new slab of PCBs: free, and ready to get pid MAXPROC + index + 1 at the first allocation
+static void _pcbSlabCtor(void* obj, int index) {
+    pcb_t* pcb = obj;
+    pcb->p_pid = MAXPROC + index + 1 - PID_SLOTS;
+    pcb->p_state = PCB_FREE;
+}
+#endif
 
 static inline void _initState(state_t* s) {
     // initialize state
@@ -34,39 +147,135 @@ static inline void _initEntry(pteEntry_t* e) {
 static inline void _initSupport(support_t* s);
 
 static inline void _initPcb(pcb_t* pcb) {
+    INIT_LIST_HEAD(&pcb->p_list);
     pcb->p_parent = NULL;
     INIT_LIST_HEAD(&pcb->p_child);
     INIT_LIST_HEAD(&pcb->p_sib);
 
-    _initState(&pcb->p_s);
+    _initState(pcb->p_s);
     // _initSupport(pcb->p_supportStruct);
 
     pcb->p_time = 0;
     pcb->p_semAdd = 0;
-    pcb->p_pid = next_pid++;
+    pcb->p_pid = _nextPid(pcb);
+    pcb->p_state = PCB_NEW;
+    pcb->p_prio = PROCESS_PRIO_LOW;
+    pcb->p_level = 0;
+    pcb->p_boostEpoch = 0;
+    pcb->p_lastCpu = -1;
+    pcb->p_rq = NULL;
+    pcb->p_affinity = ALLCPUS_MASK;
+    pcb->p_node.rb_parent = NULL;
+    pcb->p_node.rb_left = NULL;
+    pcb->p_node.rb_right = NULL;
+    pcb->p_vruntime = 0;
+    pcb->p_vbase = 0;
+    pcb->p_dispatchTime = 0;
+    pcb->p_period = 0;
+    pcb->p_budget = 0;
+    pcb->p_budgetLeft = 0;
+    pcb->p_deadline = 0;
+    pcb->p_charged = 0;
+    pcb->p_missed = 0;
 }
 
 void initPcbs() {
-    INIT_LIST_HEAD(&pcbFree_h);
-    for (int i = 0; i < MAXPROC; i++) {
-        list_add_tail(&pcbFree_table[i].p_list, &pcbFree_h);
+    pcbFree_pool = PCB_NIL;
+    for (int i = 0; i < NCPU; i++) {
+        pcbFree_cache[i] = PCB_NIL;
+        pcbFree_cacheCount[i] = 0;
+    }
+#if DYNAMIC_POOLS
+    slabCacheInit(&PcbCache, sizeof(pcb_t), _pcbSlabCtor);
+    slabCacheInit(&StateCache, sizeof(state_t), NULL);
+#endif
+    for (int i = MAXPROC - 1; i >= 0; i--) {
+        pcbFree_table[i].p_pid = i + 1 - PID_SLOTS; // the first allocation gives pid i + 1
+        pcbFree_table[i].p_state = PCB_FREE;
+        pcbFree_table[i].p_s = &pcbState_table[i];
+        pidTable[i] = NULL;
+        _stackPush(&pcbFree_pool, &pcbFree_table[i]);
     }
 }
 
 void freePcb(pcb_t* p) {
-    list_add_tail(&p->p_list, &pcbFree_h);
+    int cpu = getPRID();
+
+    p->p_state = PCB_FREE;
+#if DYNAMIC_POOLS
+    if (!_isStatic(p)) {
+        slabFree(&StateCache, p->p_s);
+        slabFree(&PcbCache, p);
+        return;
+    }
+#endif
+    pidTable[p - pcbFree_table] = NULL;
+
+    if (pcbFree_cacheCount[cpu] < PCB_CACHE_MAX) {
+        _stackPush(&pcbFree_cache[cpu], p);
+        pcbFree_cacheCount[cpu]++;
+    } else {
+        _stackPush(&pcbFree_pool, p);
+    }
 }
 
 pcb_t* allocPcb() {
-    if(list_empty(&pcbFree_h)) return NULL;
+    int cpu = getPRID();
+
+    pcb_t* pcb = _stackPop(&pcbFree_cache[cpu]);
+    if (pcb != NULL) {
+        if (pcbFree_cacheCount[cpu] > 0) pcbFree_cacheCount[cpu]--;
+    } else {
+        // the cache is empty whatever the count says: other CPUs may have stolen from it
+        pcbFree_cacheCount[cpu] = 0;
+        pcb = _refillCache(cpu);
+        if (pcb == NULL) pcb = _stealPcb(cpu);
+#if DYNAMIC_POOLS
+        if (pcb == NULL) {
+            pcb = slabAlloc(&PcbCache);
+            if (pcb == NULL) return NULL;
+
+            pcb->p_s = slabAlloc(&StateCache);
+            if (pcb->p_s == NULL) {
+                slabFree(&PcbCache, pcb);
+                return NULL;
+            }
+
+            _initPcb(pcb);
+            return pcb;
+        }
+#endif
+        if (pcb == NULL) return NULL;
+    }
 
-    pcb_t* pcb = container_of(pcbFree_h.prev, pcb_t, p_list);
-    list_del(&pcb->p_list);
-    
     _initPcb(pcb);
+    pidTable[pcb - pcbFree_table] = pcb;
     return pcb;
 }
 
+// a PCB being freed is marked PCB_FREE before it leaves pidTable, a new one
+// stays PCB_NEW until createProcess links it (see readyInsert)
+static int _pidMatch(void* obj, int pid) {
+    pcb_t* pcb = obj;
+    return pcb->p_pid == pid && pcb->p_state != PCB_FREE && pcb->p_state != PCB_NEW;
+}
+
+pcb_t* pidLookup(int pid) {
+    if (pid <= 0) return NULL;
+
+    int slot = (pid - 1) % PID_SLOTS;
+    if (slot < MAXPROC) {
+        pcb_t* pcb = pidTable[slot];
+        return (pcb != NULL && _pidMatch(pcb, pid)) ? pcb : NULL;
+    }
+#if DYNAMIC_POOLS
+    // the slab frame of a dynamic PCB is only looked at while it still belongs to PcbCache
+    return slabLookup(&PcbCache, slot - MAXPROC, _pidMatch, pid);
+#else
+    return NULL;
+#endif
+}
+
 void mkEmptyProcQ(struct list_head* head) {
     INIT_LIST_HEAD(head);
 }
@@ -97,7 +306,7 @@ pcb_t* outProcQ(struct list_head* head, pcb_t* p) {
     struct list_head* iter; 
     list_for_each(iter, head) {
         pcb_t* pcb = container_of(iter, pcb_t, p_list);
-        if(pcb->p_pid == p->p_pid) {
+        if(pcb == p) {
             list_del(iter);
             return pcb;
         }
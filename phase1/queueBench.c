@@ -0,0 +1,159 @@
+/*********************************QUEUEBENCH.C***************************
+ *
+ *	Microbenchmark of the process queue scans (phase 1).
+ *
+ *	Puts MAXPROC processes on a single process queue and on the ASL and
+ *	prints on terminal 0 the TOD ticks spent walking them: a scan of the
+ *	queue by pid (what findPcb used to do), outProcQ of the last element
+ *	and outBlockedPID over many semaphores. These walks only touch the
+ *	hot fields of pcb_t, so the ticks follow the footprint of the queue;
+ *	sizeof(pcb_t) is printed too. The benchmark uses only the phase 1
+ *	interface, so it can be built on an older tree to compare layouts.
+ *	uriscv does not model caches: on the emulator the gain shows mostly
+ *	as a smaller footprint, on real hardware also as fewer cache misses.
+ */
+
+#include "../headers/const.h"
+#include "../headers/types.h"
+
+#include <uriscv/liburiscv.h>
+#include "./headers/pcb.h"
+#include "./headers/asl.h"
+
+#define ROUNDS     8
+#define SEMAPHORES (MAXPROC / 4)
+
+#define TRANSMITTED 5
+#define CHAROFFSET  8
+#define STATUSMASK  0xFF
+#define TERM0ADDR   0x10000254
+
+typedef unsigned int devreg;
+
+int              sem[SEMAPHORES];
+pcb_t           *procp[MAXPROC];
+struct list_head queue;
+
+/* This function prints a string on terminal 0, busy waiting on every character */
+void termprint(char *str) {
+    devreg *statusp  = (devreg *)(TERM0ADDR + (TRANSTATUS * DEVREGLEN));
+    devreg *commandp = (devreg *)(TERM0ADDR + (TRANCOMMAND * DEVREGLEN));
+
+    while (*str != EOS) {
+        *commandp = (*str << CHAROFFSET) | PRINTCHR;
+        while (((*statusp) & STATUSMASK) == BUSY)
+            ;
+        if (((*statusp) & STATUSMASK) != TRANSMITTED)
+            PANIC();
+        str++;
+    }
+}
+
+/* This function prints num in decimal on terminal 0 */
+void termprintnum(unsigned int num) {
+    char buf[11];
+    int  i = 10;
+
+    buf[i] = EOS;
+    do {
+        buf[--i] = '0' + num % 10;
+        num /= 10;
+    } while (num > 0);
+    termprint(&buf[i]);
+}
+
+/* This function prints a result line: total ticks and ticks per operation */
+void report(char *name, unsigned int ticks, unsigned int ops) {
+    termprint(name);
+    termprint(": ");
+    termprintnum(ticks);
+    termprint(" ticks, ");
+    termprintnum(ticks / ops);
+    termprint(" per op\n");
+}
+
+/* This function walks the queue comparing the pids, returns the process with the given pid */
+pcb_t *scanByPid(struct list_head *head, int pid) {
+    struct list_head *iter;
+
+    list_for_each(iter, head) {
+        pcb_t *p = container_of(iter, pcb_t, p_list);
+        if (p->p_pid == pid)
+            return p;
+    }
+    return NULL;
+}
+
+
+int main(void) {
+    int          i, r;
+    cpu_t        start, end;
+    unsigned int ops = ROUNDS * MAXPROC;
+    pcb_t       *p;
+
+    initPcbs();
+    initASL();
+    mkEmptyProcQ(&queue);
+    for (i = 0; i < MAXPROC; i++) {
+        procp[i] = allocPcb();
+        if (procp[i] == NULL)
+            PANIC();
+        insertProcQ(&queue, procp[i]);
+    }
+
+    termprint("Queue benchmark, processes: ");
+    termprintnum(MAXPROC);
+    termprint(", sizeof(pcb_t): ");
+    termprintnum(sizeof(pcb_t));
+    termprint(" bytes\n");
+
+    /* every pid in turn: on average half of the queue is walked */
+    STCK(start);
+    for (r = 0; r < ROUNDS; r++) {
+        for (i = 0; i < MAXPROC; i++) {
+            if (scanByPid(&queue, procp[i]->p_pid) != procp[i])
+                PANIC();
+        }
+    }
+    STCK(end);
+    report("scan by pid", end - start, ops);
+
+    /* outProcQ of the tail walks the whole queue */
+    STCK(start);
+    for (r = 0; r < ROUNDS; r++) {
+        for (i = 0; i < MAXPROC; i++) {
+            p = container_of(queue.prev, pcb_t, p_list);
+            if (outProcQ(&queue, p) != p)
+                PANIC();
+            insertProcQ(&queue, p);
+        }
+    }
+    STCK(end);
+    report("outProcQ (tail)", end - start, ops);
+
+    /* the same processes blocked on SEMAPHORES semaphores, four per semaphore */
+    while (removeProcQ(&queue) != NULL)
+        ;
+    for (i = 0; i < MAXPROC; i++) {
+        if (insertBlocked(&sem[i % SEMAPHORES], procp[i]))
+            PANIC();
+    }
+
+    /* outBlockedPID walks the blocked processes until the pid is found */
+    STCK(start);
+    for (r = 0; r < ROUNDS; r++) {
+        for (i = 0; i < MAXPROC; i++) {
+            p = procp[i];
+            int *key = p->p_semAdd;
+            if (outBlockedPID(p->p_pid) != p)
+                PANIC();
+            insertBlocked(key, p);
+        }
+    }
+    STCK(end);
+    report("outBlockedPID + insertBlocked", end - start, ops);
+
+    termprint("Queue benchmark done\n");
+    HALT();
+    return 0;
+}
@@ -0,0 +1,214 @@
+#include "../headers/rbtree.h"
+
+static inline int _isRed(struct rb_node* n) {
+    return n != NULL && n->rb_color == RB_RED;
+}
+
+static inline int _isBlack(struct rb_node* n) {
+    return n == NULL || n->rb_color == RB_BLACK;
+}
+
+// replace the child old of parent (or the root) with new
+static inline void _changeChild(struct rb_node* old, struct rb_node* new, struct rb_node* parent, struct rb_root* root) {
+    if (parent == NULL) {
+        root->rb_node = new;
+    } else if (parent->rb_left == old) {
+        parent->rb_left = new;
+    } else {
+        parent->rb_right = new;
+    }
+}
+
+static void _rotateLeft(struct rb_node* x, struct rb_root* root) {
+    struct rb_node* y = x->rb_right;
+
+    x->rb_right = y->rb_left;
+    if (y->rb_left) y->rb_left->rb_parent = x;
+
+    y->rb_parent = x->rb_parent;
+    _changeChild(x, y, x->rb_parent, root);
+
+    y->rb_left = x;
+    x->rb_parent = y;
+}
+
+static void _rotateRight(struct rb_node* x, struct rb_root* root) {
+    struct rb_node* y = x->rb_left;
+
+    x->rb_left = y->rb_right;
+    if (y->rb_right) y->rb_right->rb_parent = x;
+
+    y->rb_parent = x->rb_parent;
+    _changeChild(x, y, x->rb_parent, root);
+
+    y->rb_right = x;
+    x->rb_parent = y;
+}
+
+void rb_insert_color(struct rb_node* node, struct rb_root* root) {
+    struct rb_node* parent;
+
+    while (_isRed(parent = node->rb_parent)) {
+        struct rb_node* gparent = parent->rb_parent;
+
+        if (parent == gparent->rb_left) {
+            struct rb_node* uncle = gparent->rb_right;
+            if (_isRed(uncle)) { // recolor and go up
+                parent->rb_color = RB_BLACK;
+                uncle->rb_color = RB_BLACK;
+                gparent->rb_color = RB_RED;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->rb_right) {
+                _rotateLeft(parent, root);
+                node = parent;
+                parent = node->rb_parent;
+            }
+            parent->rb_color = RB_BLACK;
+            gparent->rb_color = RB_RED;
+            _rotateRight(gparent, root);
+        } else {
+            struct rb_node* uncle = gparent->rb_left;
+            if (_isRed(uncle)) { // recolor and go up
+                parent->rb_color = RB_BLACK;
+                uncle->rb_color = RB_BLACK;
+                gparent->rb_color = RB_RED;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->rb_left) {
+                _rotateRight(parent, root);
+                node = parent;
+                parent = node->rb_parent;
+            }
+            parent->rb_color = RB_BLACK;
+            gparent->rb_color = RB_RED;
+            _rotateLeft(gparent, root);
+        }
+    }
+    root->rb_node->rb_color = RB_BLACK;
+}
+
+// restore the black height after removing a black node: node (maybe NULL) is its replacement, child of parent
+static void _eraseColor(struct rb_node* node, struct rb_node* parent, struct rb_root* root) {
+    struct rb_node* sibling;
+
+    while (node != root->rb_node && _isBlack(node)) {
+        if (node == parent->rb_left) {
+            sibling = parent->rb_right;
+            if (_isRed(sibling)) {
+                sibling->rb_color = RB_BLACK;
+                parent->rb_color = RB_RED;
+                _rotateLeft(parent, root);
+                sibling = parent->rb_right;
+            }
+            if (_isBlack(sibling->rb_left) && _isBlack(sibling->rb_right)) {
+                sibling->rb_color = RB_RED;
+                node = parent;
+                parent = node->rb_parent;
+            } else {
+                if (_isBlack(sibling->rb_right)) {
+                    sibling->rb_left->rb_color = RB_BLACK;
+                    sibling->rb_color = RB_RED;
+                    _rotateRight(sibling, root);
+                    sibling = parent->rb_right;
+                }
+                sibling->rb_color = parent->rb_color;
+                parent->rb_color = RB_BLACK;
+                sibling->rb_right->rb_color = RB_BLACK;
+                _rotateLeft(parent, root);
+                node = root->rb_node;
+            }
+        } else {
+            sibling = parent->rb_left;
+            if (_isRed(sibling)) {
+                sibling->rb_color = RB_BLACK;
+                parent->rb_color = RB_RED;
+                _rotateRight(parent, root);
+                sibling = parent->rb_left;
+            }
+            if (_isBlack(sibling->rb_left) && _isBlack(sibling->rb_right)) {
+                sibling->rb_color = RB_RED;
+                node = parent;
+                parent = node->rb_parent;
+            } else {
+                if (_isBlack(sibling->rb_left)) {
+                    sibling->rb_right->rb_color = RB_BLACK;
+                    sibling->rb_color = RB_RED;
+                    _rotateLeft(sibling, root);
+                    sibling = parent->rb_left;
+                }
+                sibling->rb_color = parent->rb_color;
+                parent->rb_color = RB_BLACK;
+                sibling->rb_left->rb_color = RB_BLACK;
+                _rotateRight(parent, root);
+                node = root->rb_node;
+            }
+        }
+    }
+    if (node) node->rb_color = RB_BLACK;
+}
+
+void rb_erase(struct rb_node* node, struct rb_root* root) {
+    struct rb_node *child, *parent;
+    int color;
+
+    if (node->rb_left && node->rb_right) {
+        // two children: node is replaced by its successor, which has no left child
+        struct rb_node* succ = node->rb_right;
+        while (succ->rb_left) succ = succ->rb_left;
+
+        child = succ->rb_right;
+        parent = succ->rb_parent;
+        color = succ->rb_color;
+
+        if (parent == node) {
+            parent = succ;
+        } else {
+            if (child) child->rb_parent = parent;
+            parent->rb_left = child;
+            succ->rb_right = node->rb_right;
+            node->rb_right->rb_parent = succ;
+        }
+
+        succ->rb_parent = node->rb_parent;
+        succ->rb_color = node->rb_color;
+        succ->rb_left = node->rb_left;
+        node->rb_left->rb_parent = succ;
+        _changeChild(node, succ, node->rb_parent, root);
+    } else {
+        child = node->rb_left ? node->rb_left : node->rb_right;
+        parent = node->rb_parent;
+        color = node->rb_color;
+
+        if (child) child->rb_parent = parent;
+        _changeChild(node, child, parent, root);
+    }
+
+    if (color == RB_BLACK) {
+        _eraseColor(child, parent, root);
+    }
+}
+
+struct rb_node* rb_first(const struct rb_root* root) {
+    struct rb_node* n = root->rb_node;
+    if (n == NULL) return NULL;
+
+    while (n->rb_left) n = n->rb_left;
+    return n;
+}
+
+struct rb_node* rb_next(const struct rb_node* node) {
+    if (node->rb_right) {
+        node = node->rb_right;
+        while (node->rb_left) node = node->rb_left;
+        return (struct rb_node*)node;
+    }
+
+    struct rb_node* parent;
+    while ((parent = node->rb_parent) && node == parent->rb_right) {
+        node = parent;
+    }
+    return parent;
+}
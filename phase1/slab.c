@@ -0,0 +1,240 @@
+#include "./headers/slab.h"
+
+#include <uriscv/liburiscv.h>
+
+/*
+    Slab allocator for the PCBs and semds beyond the static MAXPROC ones.
+
+    The frames between the end of the swap pool and RAMTOP (minus the frames
+    left to the stacks of the test processes) are handed out one at a time;
+    every frame is a slab: a slab_t header followed by objects of one cache.
+    Each cache keeps its slabs in three lists (partial, full, empty) under its
+    own lock. A slab that becomes empty is kept as the only spare of its
+    cache, unless free frames are scarce (SLAB_PRESSURE); when a cache finds
+    no free frame at all, the spare slabs of every cache are given back first.
+
+    Every object also has a stable index (frame number * objects per slab +
+    position), so that the PCBs can be looked up by pid.
+*/
+
+static unsigned int FrameLock;
+static int FramesReady;
+static memaddr FrameStart;
+static unsigned int FrameCount;
+static unsigned int FramesFree;
+static unsigned int FrameMap[SLAB_MAXFRAMES / 32];   /* bit set iff the frame is in use */
+static slabcache_t* FrameOwner[SLAB_MAXFRAMES];
+
+static unsigned int CachesLock;
+static slabcache_t* Caches[SLAB_MAXCACHES];
+static int CacheCount;
+
+// the first time, finds out how many frames the machine has above the swap pool
+static inline void _framesSetup(void) {
+    memaddr ramtop;
+    RAMTOP(ramtop);
+
+    FrameStart = SLAB_FRAMESTART;
+    FrameCount = 0;
+    if (ramtop > FrameStart + SLAB_STACKFRAMES * PAGESIZE) {
+        FrameCount = (ramtop - FrameStart) / PAGESIZE - SLAB_STACKFRAMES;
+    }
+    if (FrameCount > SLAB_MAXFRAMES) FrameCount = SLAB_MAXFRAMES;
+
+    FramesFree = FrameCount;
+    for (int i = 0; i < SLAB_MAXFRAMES / 32; i++) {
+        FrameMap[i] = 0;
+    }
+    FramesReady = 1;
+}
+
+static slab_t* _frameAlloc(slabcache_t* cache) {
+    slab_t* slab = NULL;
+
+    ACQUIRE_LOCK(&FrameLock);
+    if (!FramesReady) _framesSetup();
+
+    for (unsigned int f = 0; f < FrameCount && FramesFree > 0; f++) {
+        if (!(FrameMap[f / 32] & (1U << (f % 32)))) {
+            FrameMap[f / 32] |= 1U << (f % 32);
+            FrameOwner[f] = cache;
+            FramesFree--;
+            slab = (slab_t*)(FrameStart + f * PAGESIZE);
+            break;
+        }
+    }
+    RELEASE_LOCK(&FrameLock);
+    return slab;
+}
+
+static void _frameFree(slab_t* slab) {
+    unsigned int f = ((memaddr)slab - FrameStart) / PAGESIZE;
+
+    ACQUIRE_LOCK(&FrameLock);
+    FrameMap[f / 32] &= ~(1U << (f % 32));
+    FrameOwner[f] = NULL;
+    FramesFree++;
+    RELEASE_LOCK(&FrameLock);
+}
+
+// frame number of the slab holding obj, -1 if obj is not in a slab of cache
+static inline int _frameOf(slabcache_t* cache, void* obj) {
+    memaddr addr = (memaddr)obj;
+    if (!FramesReady || addr < FrameStart || addr >= FrameStart + FrameCount * PAGESIZE) return -1;
+
+    int f = (addr - FrameStart) / PAGESIZE;
+    return FrameOwner[f] == cache ? f : -1;
+}
+
+// gives back to the frame pool the spare slab of every cache: there is no free frame left
+static void _reclaimSpares(void) {
+    for (int i = 0; i < CacheCount; i++) {
+        slabcache_t* cache = Caches[i];
+        slab_t* spare = NULL;
+
+        ACQUIRE_LOCK(&cache->sc_lock);
+        if (!list_empty(&cache->sc_empty)) {
+            spare = container_of(cache->sc_empty.next, slab_t, sb_link);
+            list_del(&spare->sb_link);
+            cache->sc_slabs--;
+            cache->sc_shrinks++;
+        }
+        RELEASE_LOCK(&cache->sc_lock);
+
+        if (spare) _frameFree(spare);
+    }
+}
+
+// carves a new frame into objects; called without the lock of cache
+static slab_t* _grow(slabcache_t* cache) {
+    slab_t* slab = _frameAlloc(cache);
+    if (slab == NULL) {
+        _reclaimSpares();
+        slab = _frameAlloc(cache);
+        if (slab == NULL) return NULL;
+    }
+
+    int f = ((memaddr)slab - FrameStart) / PAGESIZE;
+    char* obj = (char*)slab + sizeof(slab_t);
+
+    slab->sb_cache = cache;
+    slab->sb_inUse = 0;
+    slab->sb_free = NULL;
+    for (int i = cache->sc_perSlab - 1; i >= 0; i--) {
+        void** o = (void**)(obj + i * cache->sc_objSize);
+        if (cache->sc_ctor) cache->sc_ctor(o, f * cache->sc_perSlab + i);
+        *o = slab->sb_free;
+        slab->sb_free = o;
+    }
+    return slab;
+}
+
+void slabCacheInit(slabcache_t* cache, unsigned int objSize, void (*ctor)(void* obj, int index)) {
+    cache->sc_lock = 0;
+    cache->sc_objSize = objSize;
+    cache->sc_perSlab = SLAB_OBJS(objSize);
+    cache->sc_ctor = ctor;
+    INIT_LIST_HEAD(&cache->sc_partial);
+    INIT_LIST_HEAD(&cache->sc_full);
+    INIT_LIST_HEAD(&cache->sc_empty);
+    cache->sc_slabs = 0;
+    cache->sc_grows = 0;
+    cache->sc_shrinks = 0;
+
+    ACQUIRE_LOCK(&CachesLock);
+    int known = 0;
+    for (int i = 0; i < CacheCount; i++) {
+        if (Caches[i] == cache) known = 1;
+    }
+    if (!known && CacheCount < SLAB_MAXCACHES) Caches[CacheCount++] = cache;
+    RELEASE_LOCK(&CachesLock);
+}
+
+void* slabAlloc(slabcache_t* cache) {
+    slab_t* slab;
+
+    ACQUIRE_LOCK(&cache->sc_lock);
+    if (list_empty(&cache->sc_partial)) {
+        if (!list_empty(&cache->sc_empty)) {
+            list_move(cache->sc_empty.next, &cache->sc_partial);
+        } else {
+            RELEASE_LOCK(&cache->sc_lock);
+            slab = _grow(cache);
+            if (slab == NULL) return NULL;
+
+            ACQUIRE_LOCK(&cache->sc_lock);
+            list_add(&slab->sb_link, &cache->sc_partial);
+            cache->sc_slabs++;
+            cache->sc_grows++;
+        }
+    }
+
+    slab = container_of(cache->sc_partial.next, slab_t, sb_link);
+    void** obj = slab->sb_free;
+    slab->sb_free = *obj;
+    slab->sb_inUse++;
+    if (slab->sb_free == NULL) {
+        list_move(&slab->sb_link, &cache->sc_full);
+    }
+    RELEASE_LOCK(&cache->sc_lock);
+    return obj;
+}
+
+void slabFree(slabcache_t* cache, void* obj) {
+    slab_t* slab = (slab_t*)((memaddr)obj & ~(PAGESIZE - 1));
+    slab_t* release = NULL;
+
+    ACQUIRE_LOCK(&cache->sc_lock);
+    if (slab->sb_free == NULL) {
+        list_move(&slab->sb_link, &cache->sc_partial);
+    }
+    *(void**)obj = slab->sb_free;
+    slab->sb_free = obj;
+
+    if (--slab->sb_inUse == 0) {
+        // keep one spare slab, unless frames are scarce
+        if (!list_empty(&cache->sc_empty) || FramesFree < SLAB_PRESSURE) {
+            list_del(&slab->sb_link);
+            cache->sc_slabs--;
+            cache->sc_shrinks++;
+            release = slab;
+        } else {
+            list_move(&slab->sb_link, &cache->sc_empty);
+        }
+    }
+    RELEASE_LOCK(&cache->sc_lock);
+
+    if (release) _frameFree(release);
+}
+
+int slabOwns(slabcache_t* cache, void* obj) {
+    return _frameOf(cache, obj) >= 0;
+}
+
+int slabIndexOf(slabcache_t* cache, void* obj) {
+    int f = _frameOf(cache, obj);
+    char* first = (char*)(FrameStart + f * PAGESIZE) + sizeof(slab_t);
+    return f * cache->sc_perSlab + ((char*)obj - first) / cache->sc_objSize;
+}
+
+// the frame may be freed and handed to another cache meanwhile: FrameLock keeps it
+// in cache until match has looked at the object
+void* slabLookup(slabcache_t* cache, int index, int (*match)(void* obj, int key), int key) {
+    int f = index / cache->sc_perSlab;
+    void* obj = NULL;
+
+    if (!FramesReady || f >= (int)FrameCount) return NULL;
+
+    ACQUIRE_LOCK(&FrameLock);
+    if (FrameOwner[f] == cache) {
+        char* first = (char*)(FrameStart + f * PAGESIZE) + sizeof(slab_t);
+        obj = first + (index % cache->sc_perSlab) * cache->sc_objSize;
+        if (!match(obj, key)) obj = NULL;
+    }
+    RELEASE_LOCK(&FrameLock);
+    return obj;
+}
+
+unsigned int slabFreeFrames(void) {
+    return FramesFree;
+}
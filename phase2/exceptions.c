@@ -19,47 +19,84 @@
 #include <uriscv/liburiscv.h>
 #include <uriscv/types.h>
 
-cpu_t lastTOD;
-
 /**
  * @brief getTimeElapsed
- * This function calculates the elapsed time since the last call.
+ * This function calculates the CPU time used by the process running on this CPU
+ * since it was dispatched or last charged, and restarts the count.
+ * Each CPU keeps its own timestamp (CpuStats[cpu].cs_chargeTOD), so the time
+ * of a process is never mixed with what happens on the other CPUs.
+ *
+ * @return The time to be added to the p_time of the current process.
  */
 cpu_t getTimeElapsed() {
+  cpustat_t* cs = &CpuStats[getPRID()];
   cpu_t currTOD;
   STCK(currTOD);
 
-  cpu_t elapsed = currTOD - lastTOD;
-  STCK(lastTOD);
+  cpu_t elapsed = currTOD - cs->cs_chargeTOD;
+  cs->cs_chargeTOD = currTOD;
+  cs->cs_busyTime += elapsed;
 
   return elapsed;
 }
 
+/**
+ * @brief _callerGone
+ * tells whether the process that trapped on this CPU has been terminated by another CPU
+ * since then (see unlinkProcess): its syscall is dropped and the CPU goes back to the scheduler.
+ * The answer holds while the caller keeps PcbLock, AslLock or the lock of this CPU,
+ * since terminateProcess takes all of them.
+ *
+ * @return 1 if CurrentProcess of this CPU has been taken away, 0 otherwise.
+ */
+static inline int _callerGone(void) {
+  return CurrentProcess[getPRID()] == NULL;
+}
+
+/**
+ * @brief _lockCaller
+ * takes the lock of this CPU for a syscall that only reads or charges the PCB of its caller.
+ * terminateProcess takes the locks of all the CPUs, so the PCB cannot be freed (and reused)
+ * while the lock is held; a caller that is already gone sends the CPU back to the scheduler.
+ *
+ * @return The process running on this CPU. The caller releases the lock of this CPU.
+ */
+static inline pcb_t* _lockCaller(void) {
+  spinLock(&CpuStats[getPRID()].cs_lock);
+  if (_callerGone()) {
+    spinUnlock(&CpuStats[getPRID()].cs_lock);
+    scheduler();
+  }
+  return CurrentProcess[getPRID()];
+}
+
 /* TLB-Refill Handler */
 void uTLB_RefillHandler() {
-  ACQUIRE_LOCK(&GlobalLock);
+  // only the page table of the process running on this CPU is read, under the (uncontended) lock of this CPU
   state_t* saved_state = (state_t*)GET_EXCEPTION_STATE_PTR(getPRID());
+  pcb_t* curr = _lockCaller();
 
   unsigned int entry_hi = saved_state->entry_hi;
   unsigned int vpn  = (entry_hi & 0xFFFFF000) >> VPNSHIFT; // Extract the VPN from entry_hi
 
   int index = (vpn == 0xBFFFF ? USERPGTBLSIZE - 1 : (vpn & 0xFF));
-  pteEntry_t* pte = &(CurrentProcess[getPRID()]->p_supportStruct->sup_privatePgTbl[index]);
+  pteEntry_t* pte = &(curr->p_supportStruct->sup_privatePgTbl[index]);
 
   setENTRYHI(pte->pte_entryHI);
   setENTRYLO(pte->pte_entryLO);
   TLBWR();
+  spinUnlock(&CpuStats[getPRID()].cs_lock);
 
-  RELEASE_LOCK(&GlobalLock);
   LDST(saved_state);
 }
 
 /**
  * @brief findPcb
- * This function searches for a process control block (PCB) with the given PID.
- * It first checks the ready queue and then checks the blocked queues of the device semaphores.
+ * This function looks up the process control block (PCB) with the given PID
+ * in the PID index of phase 1, wherever the process is (running on any CPU,
+ * ready or blocked).
  * 
- * @param pid The process ID to search for.
+ * @param pid The process ID to search for, 0 for the caller.
  * @return A pointer to the PCB if found, NULL otherwise.
  */
 static inline pcb_t* findPcb(int pid) {
@@ -68,68 +105,113 @@ static inline pcb_t* findPcb(int pid) {
     return CurrentProcess[getPRID()];
   }
 
-  // first i search it in the ready queue
-  struct list_head* iter; 
-  list_for_each(iter, &ReadyQueue) {
-    pcb_t* pcb = container_of(iter, pcb_t, p_list);
-    if(pcb->p_pid == pid) {
-      return pcb;
-    } 
-  }
+  return pidLookup(pid);
+}
 
-  // if not found in the ready queue, i search it in the blocked queues of the device semaphores
-  pcb_t* pcb = outBlockedPID(pid);
-  if (pcb != NULL) {
-    return pcb;
+/**
+ * @brief unlinkProcess
+ * This function takes a process being terminated out of the place its p_state
+ * says it is in: its ready queue, its semaphore or the CPU running it.
+ * A process running on another CPU is taken away from it, and the CPU is sent
+ * an IPI so that it goes back to the scheduler.
+ * The caller holds AslLock and the locks of all the CPUs (see terminateProcess).
+ *
+ * @param target The process to unlink.
+ */
+static inline void unlinkProcess(pcb_t* target) {
+  switch (target->p_state) {
+    case PCB_READY:
+      readyRemove(target);
+      break;
+    case PCB_BLOCKED:
+      // a periodic process waiting for its next period is in the EDF class, not on a semaphore
+      if (target->p_semAdd) {
+        outBlocked(target);
+      } else {
+        readyRemove(target);
+      }
+      break;
+    case PCB_RUNNING:
+      // CurrentProcess is the authority, p_lastCpu may lag behind it (see yield)
+      for (int i = 0; i < NCPU; i++) {
+        if (CurrentProcess[i] == target) {
+          CurrentProcess[i] = NULL;
+          if (i != getPRID()) {
+            schedKick(i);
+          }
+        }
+      }
+      break;
   }
-
-  // if it reaches this point, it means that no process was found with the given pid
-  return NULL;
 }
 
 /**
- * @brief terminateProcessSubTree
- * This function recursively terminates a process and all its children and siblings.
- * It removes the process from the ready queue and the blocked queue, and frees its PCB.
- * 
- * @param target The target process to terminate.
+ * @brief unlinkSubTree
+ * This function walks the subtree rooted at root without recursion (the tree
+ * links lead down to the first child, across to the next sibling and back up
+ * to the parent) and takes every process out of its queue or CPU.
+ * The processes are marked PCB_FREE, so pid lookups stop finding them, and
+ * collected in batch through p_list, which is unused once they are unlinked.
+ * The tree links inside the subtree are left alone: the whole batch is freed.
+ * The caller holds PcbLock, AslLock and the locks of all the CPUs (see terminateProcess).
+ *
+ * @param root The root of the subtree.
+ * @param batch The list where the processes are collected.
+ * @return The number of processes collected.
  */
-static inline void terminateProcessSubTree(pcb_t* target) {
-  if (target == NULL) return;
-
-  // Terminate all children and siblings recursively
-  if (!emptyChild(target)) {
-    terminateProcessSubTree(container_of(target->p_child.next, pcb_t, p_sib));
-  }
+static inline int unlinkSubTree(pcb_t* root, struct list_head* batch) {
+  pcb_t* node = root;
+  int count = 0;
+
+  for (;;) {
+    unlinkProcess(node);
+    node->p_state = PCB_FREE;
+    list_add_tail(&node->p_list, batch);
+    count++;
+
+    // pre-order: first the children...
+    if (!emptyChild(node)) {
+      node = container_of(node->p_child.next, pcb_t, p_sib);
+      continue;
+    }
 
-  if (!list_is_last(&target->p_sib, &target->p_parent->p_child)) {
-    terminateProcessSubTree(container_of(target->p_sib.next, pcb_t, p_sib));
+    // ...then the next sibling of the closest ancestor that has one
+    while (node != root && list_is_last(&node->p_sib, &node->p_parent->p_child)) {
+      node = node->p_parent;
+    }
+    if (node == root) break;
+    node = container_of(node->p_sib.next, pcb_t, p_sib);
   }
- 
-  // orphan the child
-  outChild(target);
-  
-  // Remove from the ready queue
-  outProcQ(&ReadyQueue, target);
-  
-  // Remove from the blocked queue
-  outBlocked(target);
-
-  // Update the process count
-  ProcessCount--;
-  
-  // Free the PCB
-  freePcb(target);
+  return count;
+}
 
-  //search for the target in the current process of each CPU and set it  to NULL
-  for (int i = 0; i < NCPU; i++) {
-    if (CurrentProcess[i] == target) {
-      CurrentProcess[i] = NULL;
-    }
+/**
+ * @brief _copyWords
+ * copies n words, four per iteration: the kernel is built without optimizations,
+ * so the loop overhead is paid for every iteration.
+ */
+static inline void _copyWords(unsigned int* d, const unsigned int* s, size_tt n) {
+  for (; n >= 4; n -= 4, d += 4, s += 4) {
+    d[0] = s[0];
+    d[1] = s[1];
+    d[2] = s[2];
+    d[3] = s[3];
   }
+  for (; n > 0; n--)
+    *d++ = *s++;
 }
 
+/**
+ * @brief memcpy
+ * called by the compiler for every structure assignment (state_t, support_t...).
+ * Word aligned copies, all the kernel structures, go a word at a time.
+ */
 void* memcpy(void* dest, const void* src, size_tt n){
+  if ((((memaddr)dest | (memaddr)src | n) & (WORDLEN - 1)) == 0) {
+    _copyWords(dest, src, n / WORDLEN);
+    return dest;
+  }
+
   char* d = dest;
   const char* s = src;
   for (; n > 0; n--)
@@ -137,105 +219,146 @@ void* memcpy(void* dest, const void* src, size_tt n){
   return dest;
 }
 
+/**
+ * @brief saveState
+ * saves the state of a process that leaves the CPU: the state the exception saved on
+ * this CPU is copied straight into the context area of the PCB, word by word, and LDST
+ * will resume the process from there. For a syscall the pc is moved past the SYSCALL
+ * instruction in the same pass, so the saved state is not touched again.
+ *
+ * @param p The process leaving the CPU.
+ * @param s The state saved by the exception.
+ * @param syscall 1 if the process leaves the CPU in a syscall, 0 for an interrupt.
+ */
+void saveState(pcb_t* p, state_t* s, int syscall) {
+  _copyWords((unsigned int*)p->p_s, (unsigned int*)s, sizeof(state_t) / WORDLEN);
+  if (syscall) p->p_s->pc_epc = s->pc_epc + 4;
+}
+
 /**
 * @brief createProcess
 * this function creates a new process with the given state and support structure.
 * the newly created process is placed on the ready queue with its parent being the current process.
 *
 * @param statep The state of the new process.
+* @param prio The priority of the new process (PROCESS_PRIO_LOW or PROCESS_PRIO_HIGH).
 * @param supportStruct The support structure of the new process.
 * @return The PID of the newly created process.
 */
-void createProcess(state_t* statep, support_t* supportStruct) {
-  ACQUIRE_LOCK(&GlobalLock);
+void createProcess(state_t* statep, int prio, support_t* supportStruct) {
   state_t* saved_state = (state_t*)GET_EXCEPTION_STATE_PTR(getPRID());
 
   //tries allocate a new PCB and if it's not possible return -1
+  //the free PCBs are lock-free, PcbLock is only needed for the process tree
   pcb_t* newProcess = allocPcb();
   if (!newProcess) {
     saved_state->reg_a0 = -1;
-    RELEASE_LOCK(&GlobalLock);
     return;
   }
 
   // Copy the state of the current process to the new process
-  newProcess->p_s = *statep;
+  *newProcess->p_s = *statep;
 
   // Copy the support structure to the new process
   newProcess->p_supportStruct = supportStruct ? supportStruct : NULL;
 
-  // Set process queue fields
-  insertProcQ(&ReadyQueue, newProcess);
-  
+  // Unknown priorities are treated as low priority
+  newProcess->p_prio = (prio == PROCESS_PRIO_HIGH) ? PROCESS_PRIO_HIGH : PROCESS_PRIO_LOW;
+
+  // Set accumulated CPU time to zero
+  newProcess->p_time = 0;
+
+  // Set semaphore address to NULL
+  newProcess->p_semAdd = NULL;
+
+  saved_state->reg_a0 = newProcess->p_pid;
+
+  spinLock(&PcbLock);
+  if (_callerGone()) {
+    spinUnlock(&PcbLock);
+    freePcb(newProcess);
+    scheduler();
+  }
+
   // Set process tree fields
   insertChild(CurrentProcess[getPRID()], newProcess);
 
   // Update process count
   ProcessCount++;
 
-  // Set accumulated CPU time to zero// block the current process
-  newProcess->p_time = 0;
+  // Set process queue fields: only now, since another CPU may dispatch it right away.
+  // readyInsert makes it PCB_READY: until then pidLookup does not find it (PCB_NEW)
+  readyInsert(newProcess);
+  spinUnlock(&PcbLock);
+}
 
-  // Set semaphore address to NULL
-  newProcess->p_semAdd = NULL;
+/**
+ * @brief _lockAllCpus
+ * takes the locks of the per-CPU state of every CPU, in CPU order.
+ * while they are held no CPU can dispatch or switch out a process, so every PCB
+ * is either running, in a ready queue or blocked on a semaphore.
+ */
+static inline void _lockAllCpus(void) {
+  for (int i = 0; i < NCPU; i++) {
+    spinLock(&CpuStats[i].cs_lock);
+  }
+}
 
-  saved_state->reg_a0 = newProcess->p_pid;
-  RELEASE_LOCK(&GlobalLock);
+static inline void _unlockAllCpus(void) {
+  for (int i = NCPU - 1; i >= 0; i--) {
+    spinUnlock(&CpuStats[i].cs_lock);
+  }
 }
 
 /**
 * @brief terminateProcess
 * this function terminates the process with the given pid, this includes all its children.
+* the process tree (PcbLock), the ASL (AslLock) and the per-CPU state of every CPU
+* are locked while the subtree is unlinked, so that no process of the subtree can be
+* moved between the queues meanwhile; the PCBs are then freed in one batch, after
+* the locks are released.
 *
 * @param pid The process ID to terminate. If pid is 0, the current process is terminated.
 */
 void terminateProcess(int pid){
-  ACQUIRE_LOCK(&GlobalLock);
-
-  pcb_t* target;
-
-  if (pid == 0) { //if the pid refers to the current process
-    target = CurrentProcess[getPRID()];
-
-    if (!emptyChild(target)) {
-      terminateProcessSubTree(container_of(target->p_child.next, pcb_t, p_sib));
-    }
-  } else {
-    target = findPcb(pid);
-    
-    if (!target) {
-      RELEASE_LOCK(&GlobalLock); 
-      return;
-    }
-
-    if (!emptyChild(target)) {
-      terminateProcessSubTree(container_of(target->p_child.next, pcb_t, p_sib));
-    }
+  struct list_head batch;
+  INIT_LIST_HEAD(&batch);
+
+  spinLock(&PcbLock);
+  spinLock(&AslLock);
+  _lockAllCpus();
+
+  pcb_t* target = findPcb(pid);
+  if (!target) {
+    _unlockAllCpus();
+    spinUnlock(&AslLock);
+    spinUnlock(&PcbLock);
+    // with pid 0 the caller itself is gone
+    if (pid == 0) scheduler();
+    return;
   }
-  
-  // orphan the child
+
+  // detach the subtree from the tree, then take all its processes out of the queues
   outChild(target);
-  
-  // Remove from the ready queue
-  outProcQ(&ReadyQueue, target);
-  
-  outBlocked(target);
+  ProcessCount -= unlinkSubTree(target, &batch);
 
-  // Update the process count
-  ProcessCount--;
+  // the caller goes on running unless it was terminated as well
+  int callerTerminated = (CurrentProcess[getPRID()] == NULL);
   
-  // Free the PCB
-  freePcb(target); // TODO: check if the function is correct
+  _unlockAllCpus();
+  spinUnlock(&AslLock);
+  spinUnlock(&PcbLock);
+
+  // nothing can reach the batch anymore: it is freed without holding any lock
+  while (!list_empty(&batch)) {
+    pcb_t* dead = container_of(batch.next, pcb_t, p_list);
+    list_del(&dead->p_list);
+    freePcb(dead);
+  }
 
-  //search for the target in the current process of each CPU and set it  to NULL
-  for (int i = 0; i < NCPU; i++) {
-    if (CurrentProcess[i] == target) {
-      CurrentProcess[i] = NULL;
-    }
+  if (callerTerminated) {
+    scheduler();
   }
-  
-  RELEASE_LOCK(&GlobalLock);
-  scheduler();
 }
 
 /**
@@ -247,27 +370,37 @@ void terminateProcess(int pid){
  * @param semAddr The address of the semaphore to wait on.
  */
 void passeren(int* semAddr) {
-  ACQUIRE_LOCK(&GlobalLock);
+  spinLock(&AslLock);
+  if (_callerGone()) {
+    spinUnlock(&AslLock);
+    scheduler();
+  }
     
   if (*semAddr == 0) {//the current process must be blocked
     state_t* saved_state = (state_t*)GET_EXCEPTION_STATE_PTR(getPRID());
 
-    //update the fields of the current process
-    CurrentProcess[getPRID()]->p_s = *saved_state;
+    // the pseudo clock only ticks while someone waits for it
+    if (semAddr == getPseudoClockSemaphore()) {
+      pseudoClockArm();
+    }
+
+    spinLock(&CpuStats[getPRID()].cs_lock);
+
+    //update the fields of the current process; the process resumes after the syscall
+    saveState(CurrentProcess[getPRID()], saved_state, 1);
     CurrentProcess[getPRID()]->p_time += getTimeElapsed();
     CurrentProcess[getPRID()]->p_semAdd = semAddr;
+    schedBlocked(CurrentProcess[getPRID()]);
 
     // remove from ready queue and insert into the semaphore's blocked queue
     if(CurrentProcess[getPRID()]){
       insertBlocked(semAddr, CurrentProcess[getPRID()]);
     }
-
-    // increment program counter by 4 so that the process skips the syscall instruction
-    CurrentProcess[getPRID()]->p_s.pc_epc += 4;
     
     CurrentProcess[getPRID()] = NULL;
 
-    RELEASE_LOCK(&GlobalLock);
+    spinUnlock(&CpuStats[getPRID()].cs_lock);
+    spinUnlock(&AslLock);
     
   /*since in this case passeren blocks the current process,
     the scheduler needs to be called in order to make another process execute
@@ -279,12 +412,12 @@ void passeren(int* semAddr) {
   */
     pcb_t* unblocked = removeBlocked(semAddr);
     if (unblocked) {  
-      insertProcQ(&ReadyQueue, unblocked);
+      readyInsert(unblocked);
     } else {
       *semAddr = 0;
     }
 
-    RELEASE_LOCK(&GlobalLock);
+    spinUnlock(&AslLock);
   }
 }
 
@@ -298,25 +431,29 @@ void passeren(int* semAddr) {
  * @param semAddr The address of the semaphore to signal.
  */
 void verhogen(int* semAddr) {
-  ACQUIRE_LOCK(&GlobalLock);
+  spinLock(&AslLock);
+  if (_callerGone()) {
+    spinUnlock(&AslLock);
+    scheduler();
+  }
   if (*semAddr == 1) {//the current process must be blocked
     // block the current process
     state_t* saved_state = (state_t*)GET_EXCEPTION_STATE_PTR(getPRID());
+    spinLock(&CpuStats[getPRID()].cs_lock);
 
-    //update the fields of the current process
-    CurrentProcess[getPRID()]->p_s = *saved_state;
+    //update the fields of the current process; the process resumes after the syscall
+    saveState(CurrentProcess[getPRID()], saved_state, 1);
     CurrentProcess[getPRID()]->p_time += getTimeElapsed();
     CurrentProcess[getPRID()]->p_semAdd = semAddr;
+    schedBlocked(CurrentProcess[getPRID()]);
 
     // remove from ready queue and insert into the semaphore's blocked queue
     insertBlocked(semAddr, CurrentProcess[getPRID()]);
     
-    // increment program counter by 4 so that the process skips the syscall instruction
-    CurrentProcess[getPRID()]->p_s.pc_epc += 4;
-
     CurrentProcess[getPRID()] = NULL;
 
-    RELEASE_LOCK(&GlobalLock);
+    spinUnlock(&CpuStats[getPRID()].cs_lock);
+    spinUnlock(&AslLock);
     
   /*since in this case verhogen blocks the current process,
     the scheduler needs to be called in order to make another process execute
@@ -330,11 +467,11 @@ void verhogen(int* semAddr) {
   */
     pcb_t* unblocked = removeBlocked(semAddr);
     if (unblocked) {
-      insertProcQ(&ReadyQueue, unblocked);
+      readyInsert(unblocked);
     } else {
       *semAddr = 1;
     }
-    RELEASE_LOCK(&GlobalLock);
+    spinUnlock(&AslLock);
   }
 }
 
@@ -343,14 +480,32 @@ void verhogen(int* semAddr) {
  * this function is called when a process wants to perform an I/O operation.
  * it sets the command value in the command address and waits for the semaphore to be signaled.
  * 
+ * the lock of the device's interrupt line is held from the command to the blocking,
+ * so the interrupt handler (which takes the same lock) always finds the process blocked.
+ * a process giving an address that is not a device command register is terminated.
+ * 
  * @param commandAddr The address of the command to perform.
  * @param commandValue The value of the command to perform.
  */
  void doIo(int* commandAddr, int commandValue) {
-  ACQUIRE_LOCK(&GlobalLock);
+  if (!isDeviceCommand(commandAddr)) {
+    terminateProcess(0);
+    return;
+  }
+
+  spinlock_t* devLock = &DeviceLocks[getDeviceLineIndex(commandAddr)];
+  spinLock(devLock);
   
   int sem_index = getDeviceSemaphoreIndex(commandAddr);
   int* semaddr = &DeviceSemaphores[sem_index];
+
+  // no command for a caller that has been terminated meanwhile
+  spinLock(&AslLock);
+  if (_callerGone()) {
+    spinUnlock(&AslLock);
+    spinUnlock(devLock);
+    scheduler();
+  }
   
   // Issue the I/O command WHILE the lock is held
   *((memaddr*)commandAddr) = commandValue;
@@ -358,20 +513,23 @@ void verhogen(int* semAddr) {
   // Now, block the current process using the logic from passeren
   // We assume the device semaphore is 0, indicating a process must wait.
   state_t* saved_state = (state_t*)GET_EXCEPTION_STATE_PTR(getPRID());
+  spinLock(&CpuStats[getPRID()].cs_lock);
   
-  CurrentProcess[getPRID()]->p_s = *saved_state;
+  saveState(CurrentProcess[getPRID()], saved_state, 1);
   CurrentProcess[getPRID()]->p_time += getTimeElapsed();
   CurrentProcess[getPRID()]->p_semAdd = semaddr;
+  schedBlocked(CurrentProcess[getPRID()]);
 
   // Add the process to the semaphore's blocked queue
   insertBlocked(semaddr, CurrentProcess[getPRID()]);
   
-  CurrentProcess[getPRID()]->p_s.pc_epc += 4;
   // Mark the current CPU as having no running process
   CurrentProcess[getPRID()] = NULL;
+  spinUnlock(&CpuStats[getPRID()].cs_lock);
+  spinUnlock(&AslLock);
   
   // Release the lock BEFORE calling the scheduler
-  RELEASE_LOCK(&GlobalLock);
+  spinUnlock(devLock);
   
   // Yield the CPU
   scheduler(); 
@@ -390,16 +548,16 @@ void waitForClock(){
  * @brief getCPUTime
  * this function is called when a process wants to get its CPU time.
  * it returns the current process's CPU time plus the amount of CPU time used during the current time slice.
+ * only the state of this CPU is touched, under its own lock (see _lockCaller).
  */
 void getCPUTime() {
-  ACQUIRE_LOCK(&GlobalLock);
-  
   state_t* savedState = (state_t*)GET_EXCEPTION_STATE_PTR(getPRID());
+  pcb_t* curr = _lockCaller();
 
-  // should return current process p_time + amount of cpu time used during the current time slice
-  savedState->reg_a0 = CurrentProcess[getPRID()]->p_time + getTimeElapsed();
-
-  RELEASE_LOCK(&GlobalLock);
+  // charge the time used during the current time slice, then return the total
+  curr->p_time += getTimeElapsed();
+  savedState->reg_a0 = curr->p_time;
+  spinUnlock(&CpuStats[getPRID()].cs_lock);
 }
 
 /**
@@ -408,9 +566,9 @@ void getCPUTime() {
  * it returns the address of the support structure of the current process.
  */
 void getSupportData() {
-  ACQUIRE_LOCK(&GlobalLock);
-  
-  support_t* supportData = CurrentProcess[getPRID()]->p_supportStruct;
+  pcb_t* curr = _lockCaller();
+  support_t* supportData = curr->p_supportStruct;
+  spinUnlock(&CpuStats[getPRID()].cs_lock);
 
   state_t* savedState = (state_t*)GET_EXCEPTION_STATE_PTR(getPRID());
 
@@ -419,8 +577,6 @@ void getSupportData() {
   } else {
     savedState->reg_a0 = 0;
   }
-  
-  RELEASE_LOCK(&GlobalLock);
 }
 
 /**
@@ -428,33 +584,215 @@ void getSupportData() {
  * this function is called when a process wants to get the process ID of its parent.
  * it returns the process ID of the current process or the parent process.
  * 
+ * the lock of this CPU is held (see _lockCaller): a parent being terminated on another
+ * CPU terminates the caller too, so while the caller is still running its parent is valid.
+ * 
  * @param parent of the process to get the ID of.
  * @return The process ID of the current process or the parent process.
  */
 void getProcessID(int parent) {
-  ACQUIRE_LOCK(&GlobalLock);
-  
   state_t* savedState = (state_t*)GET_EXCEPTION_STATE_PTR(getPRID());
+  pcb_t* curr = _lockCaller();
 
   if (parent == 0) {
-    savedState->reg_a0 = CurrentProcess[getPRID()]->p_pid;
+    savedState->reg_a0 = curr->p_pid;
   } else {
-    savedState->reg_a0 = CurrentProcess[getPRID()]->p_parent->p_pid;
+    pcb_t* parentPcb = curr->p_parent;
+    savedState->reg_a0 = parentPcb ? parentPcb->p_pid : 0;
   }
-  
-  RELEASE_LOCK(&GlobalLock);
+  spinUnlock(&CpuStats[getPRID()].cs_lock);
 }
 
-static inline void passUpToSupportLevel(int exceptionType, state_t* savedState) {
-  ACQUIRE_LOCK(&GlobalLock);
+/**
+ * @brief setAffinity
+ * this function is called when a process wants to choose the CPUs it may run on.
+ * if the CPU the process is running on is not allowed anymore, the process is moved
+ * to the ready queue of an allowed CPU and resumes there.
+ * the whole syscall runs under the lock of this CPU (see _lockCaller).
+ *
+ * @param mask The new affinity mask (bit i = CPU i), 0 means every CPU.
+ * @return The previous affinity mask, -1 if mask contains no existing CPU.
+ */
+void setAffinity(unsigned int mask) {
+  state_t* savedState = (state_t*)GET_EXCEPTION_STATE_PTR(getPRID());
+  pcb_t* curr = _lockCaller();
+
+  if (mask == 0) mask = ALLCPUS_MASK;
+  if (!(mask & ALLCPUS_MASK)) {
+    savedState->reg_a0 = -1;
+    spinUnlock(&CpuStats[getPRID()].cs_lock);
+    return;
+  }
 
-  support_t* currentSupport = (support_t*)CurrentProcess[getPRID()]->p_supportStruct;
+  savedState->reg_a0 = curr->p_affinity;
+  curr->p_affinity = mask & ALLCPUS_MASK;
 
+  if (!(curr->p_affinity & (1U << getPRID()))) {
+    // the process resumes after the syscall on one of the allowed CPUs
+    saveState(curr, savedState, 1);
+    curr->p_time += getTimeElapsed();
+    CurrentProcess[getPRID()] = NULL;
+
+    readyInsert(curr);
+    spinUnlock(&CpuStats[getPRID()].cs_lock);
+    scheduler();
+  }
+  spinUnlock(&CpuStats[getPRID()].cs_lock);
+}
+
+/**
+ * @brief yield
+ * this function is called when a process wants to give up the CPU.
+ * with pid 0 the process goes back to the ready queue and the scheduler picks the next process.
+ * with the pid of a ready process the caller hands it the rest of its time slice:
+ * the target runs right away on this CPU, without waiting for its turn in the ready queue
+ * (a producer can wake its consumer and let it run immediately).
+ *
+ * @param pid 0 for a plain yield, otherwise the process to hand the CPU to.
+ * @return 0 on success, -1 if pid is not a ready process that may run on this CPU
+ *         (the caller yields anyway). Periodic processes never take part in a handoff.
+ */
+void yield(int pid) {
+  // the PLT keeps counting below zero: an expired slice leaves nothing to hand over
+  cpu_t sliceLeft = getTIMER();
+  if (sliceLeft < 0) sliceLeft = 0;
+
+  int cpu = getPRID();
+  spinLock(&CpuStats[cpu].cs_lock);
+
+  state_t* savedState = (state_t*)GET_EXCEPTION_STATE_PTR(cpu);
+  pcb_t* curr = CurrentProcess[cpu];
+  pcb_t* target = NULL;
+
+  if (!curr) {
+    spinUnlock(&CpuStats[cpu].cs_lock);
+    scheduler();
+  }
+
+  savedState->reg_a0 = 0;
+  if (pid != 0) {
+    target = pidLookup(pid);
+    if (target && (target->p_state != PCB_READY || target->p_period || curr->p_period || !(target->p_affinity & (1U << cpu)) || !readyRemove(target))) {
+      target = NULL;
+    }
+    if (!target) savedState->reg_a0 = -1;
+  }
+
+  saveState(curr, savedState, 1);
+  curr->p_time += getTimeElapsed();
+  CurrentProcess[cpu] = target; // NULL unless the CPU is handed to target
+  if (target) {
+    target->p_state = PCB_RUNNING;
+    target->p_lastCpu = cpu;
+  }
+  readyInsert(curr);
+
+  spinUnlock(&CpuStats[cpu].cs_lock);
+
+  if (target) {
+    schedHandoff(target, sliceLeft);
+  } else {
+    scheduler();
+  }
+}
+
+/**
+ * @brief setPeriodic
+ * this function is called when a process wants to become periodic (EDF real-time class).
+ * the process is given the CPU for budget microseconds in every period, and its
+ * deadline is the end of the period; the first period starts now.
+ * the process leaves the CPU and is scheduled again in the real-time class.
+ *
+ * @param period The period in microseconds, 0 to go back to normal scheduling.
+ * @param budget The CPU time granted in every period, in microseconds.
+ * @return 0 on success, -1 if the budget is 0 or longer than the period.
+ */
+void setPeriodic(unsigned int period, unsigned int budget) {
+  spinLock(&CpuStats[getPRID()].cs_lock);
+
+  state_t* savedState = (state_t*)GET_EXCEPTION_STATE_PTR(getPRID());
+  pcb_t* curr = CurrentProcess[getPRID()];
+
+  if (!curr) {
+    spinUnlock(&CpuStats[getPRID()].cs_lock);
+    scheduler();
+  }
+
+  curr->p_time += getTimeElapsed();
+  if (edfSetPeriodic(curr, period, budget) < 0) {
+    savedState->reg_a0 = -1;
+    spinUnlock(&CpuStats[getPRID()].cs_lock);
+    return;
+  }
+  savedState->reg_a0 = 0;
+
+  // resume through the scheduler, which arms the PLT with the budget
+  saveState(curr, savedState, 1);
+  CurrentProcess[getPRID()] = NULL;
+  readyInsert(curr);
+
+  spinUnlock(&CpuStats[getPRID()].cs_lock);
+  scheduler();
+}
+
+/**
+ * @brief waitPeriod
+ * this function is called when a periodic process has finished the job of the current period.
+ * the process waits for the start of its next period, or restarts right away
+ * if the current period is already over (which counts as a missed deadline).
+ *
+ * @return The number of deadlines the process missed so far, -1 if it is not periodic.
+ */
+void waitPeriod() {
+  spinLock(&ClockLock);
+  spinLock(&CpuStats[getPRID()].cs_lock);
+
+  state_t* savedState = (state_t*)GET_EXCEPTION_STATE_PTR(getPRID());
+  pcb_t* curr = CurrentProcess[getPRID()];
+
+  if (!curr) {
+    spinUnlock(&CpuStats[getPRID()].cs_lock);
+    spinUnlock(&ClockLock);
+    scheduler();
+  }
+
+  if (!curr->p_period) {
+    savedState->reg_a0 = -1;
+    spinUnlock(&CpuStats[getPRID()].cs_lock);
+    spinUnlock(&ClockLock);
+    return;
+  }
+
+  saveState(curr, savedState, 1);
+  curr->p_time += getTimeElapsed();
+  CurrentProcess[getPRID()] = NULL;
+
+  // the result is stored before edfSuspend, which may make the process runnable again
+  cpu_t now;
+  STCK(now);
+  curr->p_s->reg_a0 = curr->p_missed + (TOD_BEFORE(now, curr->p_deadline) ? 0 : 1);
+  edfSuspend(curr, 1, now);
+  spinUnlock(&CpuStats[getPRID()].cs_lock);
+
+  intervalTimerUpdate();
+  spinUnlock(&ClockLock);
+  scheduler();
+}
+
+/**
+ * @brief passUpToSupportLevel
+ * the state is copied once, word by word, into the support structure: it cannot stay
+ * in the BIOSDATAPAGE, since the handler makes syscalls on this CPU. The handler is
+ * started on a stack of the support structure, so it finds the structure (and the state)
+ * from its stack pointer, without a GETSUPPORTPTR (see SUPPORT_FROM_STACK in phase 3).
+ * the lock of this CPU, held by the caller, is released once the state is copied.
+ */
+static inline void passUpToSupportLevel(support_t* currentSupport, int exceptionType, state_t* savedState) {
   currentSupport->sup_exceptState[exceptionType] = *savedState;
+  spinUnlock(&CpuStats[getPRID()].cs_lock);
 
   context_t* currentContext = &currentSupport->sup_exceptContext[exceptionType];
 
-  RELEASE_LOCK(&GlobalLock);
   LDCXT(currentContext->stackPtr, currentContext->status, currentContext->pc);
 }
 
@@ -463,27 +801,30 @@ static inline void passUpToSupportLevel(int exceptionType, state_t* savedState)
  * this function is called when a program trap occurs.
  * if the current process has a support structure, it passes the exception to the support level.
  * otherwise it terminates the process.
+ * curr comes from _lockCaller: the lock of this CPU is held, and released here.
  */
-static inline void handleProgramTrap(state_t* savedState) {
-  ACQUIRE_LOCK(&GlobalLock);
-  support_t* currentSupport = CurrentProcess[getPRID()]->p_supportStruct;
-  RELEASE_LOCK(&GlobalLock);
+static inline void handleProgramTrap(pcb_t* curr, state_t* savedState) {
+  support_t* currentSupport = curr->p_supportStruct;
 
   if (currentSupport) {
-    passUpToSupportLevel(GENERALEXCEPT, savedState);
+    passUpToSupportLevel(currentSupport, GENERALEXCEPT, savedState);
   } else {
+    spinUnlock(&CpuStats[getPRID()].cs_lock);
     terminateProcess(0);
   }
 }
 
-static inline void handleTLBException(state_t* savedState) {
-  ACQUIRE_LOCK(&GlobalLock);
-  support_t* currentSupport = CurrentProcess[getPRID()]->p_supportStruct;
-  RELEASE_LOCK(&GlobalLock);
-  
+/**
+ * @brief handleTLBException
+ * same as handleProgramTrap, for the TLB exceptions that are not a TLB refill.
+ */
+static inline void handleTLBException(pcb_t* curr, state_t* savedState) {
+  support_t* currentSupport = curr->p_supportStruct;
+
   if (currentSupport) {
-    passUpToSupportLevel(PGFAULTEXCEPT, savedState);
+    passUpToSupportLevel(currentSupport, PGFAULTEXCEPT, savedState);
   } else {
+    spinUnlock(&CpuStats[getPRID()].cs_lock);
     terminateProcess(0);
   }
 }
@@ -491,11 +832,11 @@ static inline void handleTLBException(state_t* savedState) {
 void SYSCALL_handler(state_t* exceptionState) {
   if (!(exceptionState->status & MSTATUS_MPP_MASK)) {
     exceptionState->cause = PRIVINSTR;
-    handleProgramTrap(exceptionState);
+    handleProgramTrap(_lockCaller(), exceptionState);
   } else {
     switch (exceptionState->reg_a0) {
       case CREATEPROCESS:
-        createProcess((state_t*)exceptionState->reg_a1, (support_t*)exceptionState->reg_a3);
+        createProcess((state_t*)exceptionState->reg_a1, exceptionState->reg_a2, (support_t*)exceptionState->reg_a3);
         break;
       case TERMPROCESS:
         terminateProcess(exceptionState->reg_a1); //termina il controllo
@@ -521,8 +862,20 @@ void SYSCALL_handler(state_t* exceptionState) {
       case GETPROCESSID:
         getProcessID(exceptionState->reg_a1);
         break;
+      case YIELD:
+        yield(exceptionState->reg_a1);
+        break;
+      case SETAFFINITY:
+        setAffinity(exceptionState->reg_a1);
+        break;
+      case SETPERIODIC:
+        setPeriodic(exceptionState->reg_a1, exceptionState->reg_a2);
+        break;
+      case WAITPERIOD: // blocking
+        waitPeriod();
+        break;
       default:
-        handleProgramTrap(exceptionState);
+        handleProgramTrap(_lockCaller(), exceptionState);
         break;
     }
     exceptionState->pc_epc += 4;
@@ -540,9 +893,13 @@ void exceptionHandler(void) {
     INTERRUPT_handler();
     return;
   }
+  // the process was terminated by another CPU while it was running and trapped before noticing
+  if (!CurrentProcess[getPRID()]) {
+    scheduler();
+  }
   //TLB exception
   if (cause >= 24 && cause <= 28 ) {
-    handleTLBException(exceptionState);
+    handleTLBException(_lockCaller(), exceptionState);
     return;      
   } 
   //SYSCALL exception
@@ -552,7 +909,7 @@ void exceptionHandler(void) {
   }
   //trap exception
   if ((cause >= 0 && cause <= 7) || cause == 9 || cause == 10 || (cause >= 12 && cause <= 23)) {
-    handleProgramTrap(exceptionState);
+    handleProgramTrap(_lockCaller(), exceptionState);
     return;
   }
   
@@ -25,13 +25,15 @@
 
 #include "../../phase1/headers/pcb.h"
 #include "../../phase1/headers/asl.h"
+#include "./spinlock.h"
 #include "initial.h"
 
 void* memcpy(void* dest, const void* src, size_tt n);
 
 cpu_t getTimeElapsed(void);
+void saveState(pcb_t* p, state_t* s, int syscall);
 
-void createProcess(state_t *statep, support_t *supportStruct);
+void createProcess(state_t *statep, int prio, support_t *supportStruct);
 void terminateProcess(int pid);
 void passeren(int* semAddr);
 void verhogen(int* semAddr);
@@ -40,6 +42,10 @@ void getCPUTime(void);
 void waitForClock(void);
 void getSupportData(void);
 void getProcessID(int parent);
+void yield(int pid);
+void setAffinity(unsigned int mask);
+void setPeriodic(unsigned int period, unsigned int budget);
+void waitPeriod(void);
 
 void exceptionHandler(void);
 void SYSCALL_handler(state_t* exceptionState);
@@ -48,18 +54,26 @@ void passupOrDie(int exceptionIndex);
 // extern void uTLB_RefillHandler(void);
 
 extern unsigned int ProcessCount;
-extern struct list_head ReadyQueue;
+extern readyq_t ReadyQueue[NCPU];
 extern pcb_t* CurrentProcess[NCPU];
+extern cpustat_t CpuStats[NCPU];
 extern int DeviceSemaphores[SEMDEVLEN];
 extern int PseudoClock;
-extern unsigned int GlobalLock;
+extern spinlock_t PcbLock;
+extern spinlock_t AslLock;
+extern spinlock_t ClockLock;
+extern spinlock_t DeviceLocks[N_DEVLINES];
 
 extern void scheduler();
 
 extern int* getPseudoClockSemaphore(void);
 extern int getDeviceSemaphoreIndex(int* commandAddr);
+extern int getDeviceLineIndex(int* commandAddr);
+extern int isDeviceCommand(int* commandAddr);
 extern int getHighestPriorityDeviceNumber(void);
 extern int getLineNo(void);
+extern void pseudoClockArm(void);
+extern void intervalTimerUpdate(void);
 
 extern void INTERRUPT_handler();
 
@@ -19,6 +19,7 @@
 
 // Semaphore helper function declarations
 int* getPseudoClockSemaphore(void);
+extern void pseudoClockStart(void);
 // int* getDeviceSemaphore(int commandAddr);
 
 extern void test();
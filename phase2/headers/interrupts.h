@@ -19,25 +19,35 @@
 
 #include "../../phase1/headers/pcb.h"
 #include "../../phase1/headers/asl.h"
+#include "./spinlock.h"
 #include "initial.h"
 
 int  getLineNo();
 int  getHighestPriorityDeviceNumber();
 int  getDeviceSemaphoreIndex(int* commandAddr);
+int  getDeviceLineIndex(int* commandAddr);
+int  isDeviceCommand(int* commandAddr);
 void handleDeviceInterrupt();
+void intervalTimerUpdate();
+void pseudoClockStart();
+void pseudoClockArm();
 void handlePseudoClockInterrupt();
+void handleIPIInterrupt();
 void handleProcessLocalTimerInterrupt();
 void INTERRUPT_handler();
 
 extern pcb_t* CurrentProcess[NCPU];
 extern unsigned int ProcessCount;
-extern struct list_head ReadyQueue;
+extern readyq_t ReadyQueue[NCPU];
 extern int DeviceSemaphores[SEMDEVLEN];
 extern int* getPseudoClockSemaphore();
-extern unsigned int GlobalLock;
+extern spinlock_t PcbLock;
+extern spinlock_t AslLock;
+extern spinlock_t ClockLock;
+extern spinlock_t DeviceLocks[N_DEVLINES];
 extern void verhogen(int* semAddr);
 extern void* memcpy(void* dest, const void* src, size_tt n);
 extern cpu_t getTimeElapsed(void);
 
-extern cpu_t lastTOD;
+extern cpustat_t CpuStats[NCPU];
 #endif // INTERRUPTS_H
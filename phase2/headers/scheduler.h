@@ -18,14 +18,33 @@
 
 #include "../../phase1/headers/pcb.h"
 #include "../../phase1/headers/asl.h"
+#include "./spinlock.h"
 
 extern unsigned int ProcessCount;
-extern struct list_head ReadyQueue;
+extern readyq_t ReadyQueue[NCPU];
 extern pcb_t* CurrentProcess[NCPU];
+extern cpustat_t CpuStats[NCPU];
+extern balancestat_t BalanceStats;
 extern int DeviceSemaphores[SEMDEVLEN];
 extern int PseudoClock;
-extern unsigned int GlobalLock;
+extern spinlock_t PcbLock;
+extern spinlock_t AslLock;
+extern spinlock_t ClockLock;
+extern spinlock_t DeviceLocks[N_DEVLINES];
 
+void initReadyQueues(void);
+void readyInsert(pcb_t* p);
+pcb_t* readyRemove(pcb_t* p);
+int readyShouldPreempt(pcb_t* curr);
+void schedSliceExpired(pcb_t* p);
+void schedBlocked(pcb_t* p);
+void schedBalance(void);
+int edfSetPeriodic(pcb_t* p, unsigned int period, unsigned int budget);
+void edfSuspend(pcb_t* p, int done, cpu_t now);
+void edfRelease(cpu_t now);
+int edfNextRelease(cpu_t* release);
+void schedHandoff(pcb_t* next, cpu_t slice);
+void schedKick(int cpu);
 void scheduler();
 
 #endif // SCHEDULER_H
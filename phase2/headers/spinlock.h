@@ -0,0 +1,34 @@
+/**
+ * @file spinlock.h
+ *
+ * @brief Header file for the kernel spinlocks.
+ *
+ * Ticket spinlocks built on the ACQUIRE_LOCK/RELEASE_LOCK primitives of
+ * liburiscv: CPUs get the lock in the order in which they asked for it.
+ * With LOCK_PROFILE spinLock also records wait and hold time per call site.
+ */
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include <uriscv/liburiscv.h>
+
+#include "../../headers/types.h"
+
+void spinInit(spinlock_t* lock);
+void spinUnlock(spinlock_t* lock);
+
+#if LOCK_PROFILE
+/* every call site gets its own static counters, registered the first time it takes the lock */
+#define spinLock(lock)                                                        \
+  do {                                                                        \
+    static lockprof_t _lockSite = {.lp_file = __FILE__, .lp_line = __LINE__}; \
+    spinLockAt((lock), &_lockSite);                                           \
+  } while (0)
+
+void spinLockAt(spinlock_t* lock, lockprof_t* site);
+void lockProfileDump(void);
+#else
+void spinLock(spinlock_t* lock);
+#endif
+
+#endif // SPINLOCK_H
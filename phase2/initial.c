@@ -32,10 +32,25 @@
 
 // Declaration of the kernel variables that will also be shared with the other modules
 unsigned int ProcessCount;
-struct list_head ReadyQueue;
+readyq_t ReadyQueue[NCPU];
 pcb_t* CurrentProcess[NCPU];
+cpustat_t CpuStats[NCPU];
+balancestat_t BalanceStats;
 int DeviceSemaphores[NRSEMAPHORES];
-unsigned int GlobalLock;
+
+/*
+ * Kernel locks (each CPU also has its own lock, CpuStats[cpu].cs_lock).
+ * When more than one is needed they are always taken in this order:
+ *   DeviceLocks[line] -> PcbLock -> AslLock -> ClockLock -> cs_lock (by CPU number)
+ *   -> BoostLock, BalanceLock -> EdfLock -> rq_lock (by CPU number) -> IdleLock
+ * The syscalls that only look at the calling process (GETTIME, GETSUPPORTPTR,
+ * GETPROCESSID), the TLB refill and the pass up to the support level take only
+ * the cs_lock of their own CPU, which another CPU takes only in terminateProcess.
+ */
+spinlock_t PcbLock;                 /* process tree and ProcessCount (the free PCBs are lock-free) */
+spinlock_t AslLock;                 /* ASL and semaphore values */
+spinlock_t ClockLock;               /* pseudo clock and interval timer */
+spinlock_t DeviceLocks[N_DEVLINES]; /* one per interrupt line: a device command and its interrupt */
 
 /**
  * @brief Initializes the device semaphores.
@@ -48,6 +63,18 @@ static inline void _initDeviceSemaphores(void) {
   }
 }
 
+/**
+ * @brief Initializes the kernel locks.
+ */
+static inline void _initLocks(void) {
+  spinInit(&PcbLock);
+  spinInit(&AslLock);
+  spinInit(&ClockLock);
+  for (int i = 0; i < N_DEVLINES; i++) {
+    spinInit(&DeviceLocks[i]);
+  }
+}
+
 /**
  * @brief Initializes the array of current processes.
  *
@@ -59,6 +86,25 @@ static inline void _initCurrentProcessArray(void) {
   }
 }
 
+/**
+ * @brief Initializes the time accounting of every CPU.
+ *
+ * This function clears the idle and busy counters and starts the charging
+ * interval of every CPU from the current TOD.
+ */
+static inline void _initCpuStats(void) {
+  cpu_t now;
+  STCK(now);
+  for (int i = 0; i < NCPU; i++) {
+    spinInit(&CpuStats[i].cs_lock);
+    CpuStats[i].cs_chargeTOD = now;
+    CpuStats[i].cs_idle = 0;
+    CpuStats[i].cs_idleSince = 0;
+    CpuStats[i].cs_idleTime = 0;
+    CpuStats[i].cs_busyTime = 0;
+  }
+}
+
 /*
  * @brief Initializes the passup vector for a CPU.
  *
@@ -89,13 +135,13 @@ static inline void _initPassupVector(void) {
 static inline pcb_t* _initFirstPCB(void) {
   pcb_t* p = allocPcb();
   if (!p) PANIC();
-  p->p_s.mie = MIE_ALL;
-  p->p_s.status = MSTATUS_MPIE_MASK | MSTATUS_MPP_M;
+  p->p_s->mie = MIE_ALL;
+  p->p_s->status = MSTATUS_MPIE_MASK | MSTATUS_MPP_M;
   p->p_semAdd = NULL;
   p->p_time = 0;
   p->p_supportStruct = NULL;
-  RAMTOP(p->p_s.reg_sp);
-  p->p_s.pc_epc = (memaddr) test;
+  RAMTOP(p->p_s->reg_sp);
+  p->p_s->pc_epc = (memaddr) test;
   
   return p;
 }
@@ -110,15 +156,15 @@ static inline void _initOtherPCBs(void) {
     pcb_t* p = allocPcb();
     if (!p) PANIC();
 
-    p->p_s.status = MSTATUS_MPP_M;
-    p->p_s.pc_epc = (memaddr) scheduler;
-    p->p_s.reg_sp = 0x20020000 + (i * PAGESIZE);
+    p->p_s->status = MSTATUS_MPP_M;
+    p->p_s->pc_epc = (memaddr) scheduler;
+    p->p_s->reg_sp = 0x20020000 + (i * PAGESIZE);
     
     p->p_semAdd = NULL;
     p->p_time = 0;
     p->p_supportStruct = NULL; 
 
-    INITCPU(i, &p->p_s);
+    INITCPU(i, p->p_s);
   }
 }
 
@@ -193,17 +239,18 @@ int main(void) {
 
   // Initialize all the previously declared variables 
   ProcessCount = 0;
-  GlobalLock = 0;
-  INIT_LIST_HEAD(&ReadyQueue);
+  _initLocks();
+  initReadyQueues();
   _initDeviceSemaphores();
   _initCurrentProcessArray();
+  _initCpuStats();
 
-  // load the system wide interval timer
-  LDIT(PSECOND); 
+  // start the pseudo clock, the interval timer is armed only while someone waits for it
+  pseudoClockStart();
   
   // Initialize the first process control block
   pcb_t* p = _initFirstPCB();
-  insertProcQ(&ReadyQueue, p);
+  readyInsert(p);
   ProcessCount++;
  
   // Interrupts
@@ -35,6 +35,10 @@
 int getLineNo() {
   int cause = getCAUSE() & CAUSE_EXCCODE_MASK;
   
+  if (cause == IL_IPI) {
+    return 0; // Inter-processor interrupt
+  }
+
   if (cause == IL_CPUTIMER) {
     return 1; // PLT
   }
@@ -63,7 +67,7 @@ int getLineNo() {
     return 7; // Terminal Device
   }
 
-  return 0; // Invalid line number
+  return -1; // Invalid line number
 }
 
 /**
@@ -86,6 +90,39 @@ int getHighestPriorityDeviceNumber() {
   return dev_no;
 }
 
+/**
+ * @brief getDeviceLineIndex
+ * This function returns the index in DeviceLocks of the interrupt line of a device,
+ * given one of its command registers: 0 for the disks (line 3) up to 4 for the terminals (line 7).
+ *
+ * @param commandAddr The command address of the device.
+ * @return The interrupt line of the device minus IL_FIRST_DEVICE_LINE.
+ */
+int getDeviceLineIndex(int* commandAddr) {
+  return ((memaddr)commandAddr - START_DEVREG) / INT_LINE_OFFSET;
+}
+
+/**
+ * @brief isDeviceCommand
+ * This function tells whether an address given to DOIO is the command register of a device
+ * (RECV_COMMAND_OFFSET or TRANSM_COMMAND_OFFSET for a terminal), the only addresses
+ * getDeviceLineIndex and getDeviceSemaphoreIndex are defined for.
+ *
+ * @param commandAddr The address to check.
+ * @return 1 if commandAddr is a command register, 0 otherwise.
+ */
+int isDeviceCommand(int* commandAddr) {
+  // unsigned: an address below START_DEVREG wraps around and is out of range as well
+  memaddr offset = (memaddr)commandAddr - START_DEVREG;
+  if (offset >= N_DEVLINES * INT_LINE_OFFSET) return 0;
+
+  memaddr reg = offset % DEVREGSIZE;
+  if (offset / INT_LINE_OFFSET == N_DEVLINES - 1) {
+    return reg == RECV_COMMAND_OFFSET || reg == TRANSM_COMMAND_OFFSET;
+  }
+  return reg == RECV_COMMAND_OFFSET; // the command register of the other devices
+}
+
 /**
  * @brief getDeviceSemaphoreIndex
  * This function calculates the semaphore index for a device based on its command address.
@@ -135,6 +172,40 @@ int getDeviceSemaphoreIndex(int* commandAddr) {
   }
 }
 
+/**
+ * @brief _returnFromInterrupt
+ * This function gives the CPU back after an interrupt has been handled.
+ *
+ * @details
+ *  - If no process was running on this CPU, the scheduler is called.
+ *  - If the interrupt made runnable a process with a higher priority than the
+ *    running one, the running process is put back in the ready queue and the
+ *    scheduler is called, so that the high priority process does not wait
+ *    for the end of the time slice.
+ *  - Otherwise the interrupted state of the running process is reloaded.
+ */
+static inline void _returnFromInterrupt(void) {
+  pcb_t* curr = CurrentProcess[getPRID()];
+  state_t* saved_state = (state_t*)GET_EXCEPTION_STATE_PTR(getPRID());
+
+  if (!curr) {
+    scheduler();
+  } else if (readyShouldPreempt(curr)) {
+    spinLock(&CpuStats[getPRID()].cs_lock);
+    // curr may have been terminated by another CPU since it was read
+    if (CurrentProcess[getPRID()] == curr) {
+      saveState(curr, saved_state, 0);
+      curr->p_time += getTimeElapsed();
+      CurrentProcess[getPRID()] = NULL;
+      readyInsert(curr);
+    }
+    spinUnlock(&CpuStats[getPRID()].cs_lock);
+    scheduler();
+  } else {
+    LDST(saved_state);
+  }
+}
+
 /**
  * @brief handleDeviceInterrupt
  * 
@@ -147,15 +218,23 @@ int getDeviceSemaphoreIndex(int* commandAddr) {
  *  - If the receive status indicates a received character, it acknowledges the receive interrupt.
  *  - For non-terminal devices, it reads the receive status and acknowledges the interrupt.
  *  - It then unblocks the corresponding semaphore and sets the return value in the PCB.
- *  - Finally, it checks if the current process is null and either schedules or loads the state of the current process.
+ *  - Finally, it either schedules or resumes the current process (see _returnFromInterrupt).
  */
 void handleDeviceInterrupt() {
   int int_line = getLineNo();
+
+  // INTERRUPT_handler sends here every cause that is not an IPI or a timer, -1 included
+  if (int_line < IL_FIRST_DEVICE_LINE || int_line >= IL_FIRST_DEVICE_LINE + N_DEVLINES) {
+    PANIC();
+    return;
+  }
+
   int dev_no = getHighestPriorityDeviceNumber();
 
   memaddr dev_base = START_DEVREG + ((int_line - 3) * INT_LINE_OFFSET) + (dev_no * DEVREGSIZE);
+  spinlock_t* devLock = &DeviceLocks[int_line - IL_FIRST_DEVICE_LINE];
 
-  ACQUIRE_LOCK(&GlobalLock);
+  spinLock(devLock);
   if (int_line == 7) {
     // Read status registers first
     memaddr transm_status = *(memaddr*)(dev_base + TRANSM_STATUS_OFFSET);
@@ -169,16 +248,19 @@ void handleDeviceInterrupt() {
       int semIndex = getDeviceSemaphoreIndex((int*)(dev_base + TRANSM_COMMAND_OFFSET));
       int* semaddr = &DeviceSemaphores[semIndex];
       
-      pcb_t* unblocked = headBlocked(semaddr);
+      spinLock(&AslLock);
+      pcb_t* unblocked = removeBlocked(semaddr);
       if (!unblocked) {
-        RELEASE_LOCK(&GlobalLock);
-        return; // No process waiting on the semaphore
+        spinUnlock(&AslLock);
+        spinUnlock(devLock);
+        _returnFromInterrupt(); // No process waiting on the semaphore
       }
 
-      unblocked->p_s.reg_a0 = transm_status;
+      unblocked->p_s->reg_a0 = transm_status;
 
       *semaddr = 1;
-      insertProcQ(&ReadyQueue, unblocked);
+      readyInsert(unblocked);
+      spinUnlock(&AslLock);
     } else {
       // handle receive interrupt
       *(memaddr*)(dev_base + RECV_COMMAND_OFFSET) = ACK;
@@ -186,15 +268,18 @@ void handleDeviceInterrupt() {
       int semIndex = getDeviceSemaphoreIndex((int*)(dev_base + RECV_COMMAND_OFFSET));
       int* semaddr = &DeviceSemaphores[semIndex];
 
-      pcb_t* unblocked = headBlocked(semaddr);
+      spinLock(&AslLock);
+      pcb_t* unblocked = removeBlocked(semaddr);
       if (!unblocked) {
-        RELEASE_LOCK(&GlobalLock);
-        return; // No process waiting on the semaphore
+        spinUnlock(&AslLock);
+        spinUnlock(devLock);
+        _returnFromInterrupt(); // No process waiting on the semaphore
       }
 
-      unblocked->p_s.reg_a0 = recv_status;
+      unblocked->p_s->reg_a0 = recv_status;
       *semaddr = 1;
-      insertProcQ(&ReadyQueue, unblocked);
+      readyInsert(unblocked);
+      spinUnlock(&AslLock);
     }
   } else {
     
@@ -205,90 +290,227 @@ void handleDeviceInterrupt() {
     int semIndex = getDeviceSemaphoreIndex((int*)(dev_base + 0x4));
     int* semaddr = &DeviceSemaphores[semIndex];
 
-    pcb_t* unblocked = headBlocked(semaddr);
+    spinLock(&AslLock);
+    pcb_t* unblocked = removeBlocked(semaddr);
     if (!unblocked) {
-      RELEASE_LOCK(&GlobalLock);
-      return; // No process waiting on the semaphore
+      spinUnlock(&AslLock);
+      spinUnlock(devLock);
+      _returnFromInterrupt(); // No process waiting on the semaphore
     }
 
-    unblocked->p_s.reg_a0 = status;
+    unblocked->p_s->reg_a0 = status;
     *semaddr = 1;
-    insertProcQ(&ReadyQueue, unblocked);
+    readyInsert(unblocked);
+    spinUnlock(&AslLock);
   }
 
-  RELEASE_LOCK(&GlobalLock);
+  spinUnlock(devLock);
 
-  if (!CurrentProcess[getPRID()]) {
-    scheduler();
-  } else {
-    LDST(&CurrentProcess[getPRID()]->p_s);
-  }
+  _returnFromInterrupt();
 }
 
 /**
  * @brief handleProcessLocalTimerInterrupt
  * 
  * This function handles the process local timer interrupt.
- * It sets the timer to the timeslice value and saves the current process state.
- * It then inserts the current process into the ready queue and calls the scheduler.
+ * It saves the current process state, lets the MLFQ policy demote it
+ * and inserts it into the ready queue; the scheduler then arms the timer
+ * with the time slice of the next process.
+ * For a periodic process the PLT marks the end of its budget instead:
+ * the process is suspended until its next period (edfSuspend).
  *
  * @details
- *   - It acquires the global lock to ensure mutual exclusion.
- *   - It sets the timer to the timeslice value.
+ *   - It acquires the lock of this CPU (and the ClockLock for a periodic process).
  *   - It saves the current process state in the saved_state variable.
- *   - It then inserts the current process into the ready queue.
- *   - Finally, it releases the lock and calls the scheduler.
+ *   - It charges the elapsed time slice to the current process.
+ *   - A periodic process is suspended until its next period.
+ *   - Otherwise it demotes the current process (schedSliceExpired)
+ *     and inserts it into the ready queue.
+ *   - It gives the load balancer the chance to run (schedBalance).
+ *   - Finally, it releases the locks and calls the scheduler.
  */
 void handleProcessLocalTimerInterrupt() {
-  ACQUIRE_LOCK(&GlobalLock);
-  
-  setTIMER(TIMESLICE * TIMESCALEADDR);
+  int cpu = getPRID();
+  pcb_t* curr = CurrentProcess[cpu];
+
+  // the process was terminated by another CPU while it was running
+  if (!curr) scheduler();
+
+  int periodic = curr->p_period != 0;
+
+  // the interval timer may have to be reprogrammed for the release of a periodic process
+  if (periodic) spinLock(&ClockLock);
+  spinLock(&CpuStats[cpu].cs_lock);
+
+  // ...or after it was read above
+  if (CurrentProcess[cpu] != curr) {
+    spinUnlock(&CpuStats[cpu].cs_lock);
+    if (periodic) spinUnlock(&ClockLock);
+    scheduler();
+  }
   
-  state_t* saved_state = (state_t*)GET_EXCEPTION_STATE_PTR(getPRID());
-  CurrentProcess[getPRID()]->p_s = *saved_state;
- 
-  insertProcQ(&ReadyQueue, CurrentProcess[getPRID()]);
+  state_t* saved_state = (state_t*)GET_EXCEPTION_STATE_PTR(cpu);
+  saveState(curr, saved_state, 0);
+  curr->p_time += getTimeElapsed();
+  CurrentProcess[cpu] = NULL;
+
+  if (periodic) {
+    // a periodic process used up its budget: it waits for its next period
+    cpu_t now;
+    STCK(now);
+    edfSuspend(curr, 0, now);
+    spinUnlock(&CpuStats[cpu].cs_lock);
+    intervalTimerUpdate();
+    spinUnlock(&ClockLock);
+  } else {
+    // the whole slice was used: demote the process before queueing it again
+    schedSliceExpired(curr);
+    readyInsert(curr);
+    spinUnlock(&CpuStats[cpu].cs_lock);
+  }
+
+  // the timer also drives the cross-CPU load balancer
+  schedBalance();
 
-  RELEASE_LOCK(&GlobalLock);
   scheduler();
 }
 
+/* TOD of the last pseudo clock tick, the ticks keep their 100ms phase from here */
+static cpu_t PseudoClockTOD;
+/* 1 while the interval timer is counting toward the next tick */
+static int PseudoClockArmed;
+
+/**
+ * @brief intervalTimerUpdate
+ *
+ * This function programs the interval timer for the earliest pending event:
+ * the next pseudo clock tick, if someone waits for it, or the release of the next periodic process.
+ * With no pending event the timer is parked.
+ * It must be called holding the ClockLock.
+ */
+void intervalTimerUpdate() {
+  cpu_t now, next, release;
+  int pending = 0;
+  STCK(now);
+
+  if (PseudoClockArmed) {
+    next = PseudoClockTOD + PSECOND * (*((cpu_t*)TIMESCALEADDR));
+    pending = 1;
+  }
+  if (edfNextRelease(&release) && (!pending || TOD_BEFORE(release, next))) {
+    next = release;
+    pending = 1;
+  }
+
+  if (!pending) {
+    *((cpu_t*)INTERVALTMR) = TIMER_PARKED;
+  } else {
+    // an event that is already due fires right away
+    *((cpu_t*)INTERVALTMR) = TOD_BEFORE(now, next) ? next - now : 1;
+  }
+}
+
+/**
+ * @brief pseudoClockStart
+ *
+ * This function starts the pseudo clock with the interval timer parked:
+ * the timer is only programmed by pseudoClockArm, when someone waits for a tick.
+ */
+void pseudoClockStart() {
+  STCK(PseudoClockTOD);
+  PseudoClockArmed = 0;
+  *((cpu_t*)INTERVALTMR) = TIMER_PARKED;
+}
+
+/**
+ * @brief pseudoClockArm
+ *
+ * This function programs the interval timer for the next pseudo clock tick, if it is not already counting.
+ * The tick is placed on the 100ms grid started by the last tick, so a waiter wakes up
+ * exactly when it would have with a free running pseudo clock.
+ * It must be called holding the AslLock, before the waiter is blocked: the tick
+ * handler takes the same lock to wake the waiters up, so none of them can be missed.
+ */
+void pseudoClockArm() {
+  spinLock(&ClockLock);
+  if (PseudoClockArmed) {
+    spinUnlock(&ClockLock);
+    return;
+  }
+
+  cpu_t now;
+  STCK(now);
+  unsigned int period = PSECOND * (*((unsigned int*)TIMESCALEADDR));
+  // unsigned: the TOD wraps, and a signed modulo of a negative distance would move the grid backwards
+  unsigned int elapsed = (unsigned int)now - (unsigned int)PseudoClockTOD;
+
+  // move to the last tick of the grid that would have fired by now
+  PseudoClockTOD += elapsed - (elapsed % period);
+  PseudoClockArmed = 1;
+  intervalTimerUpdate();
+  spinUnlock(&ClockLock);
+}
+
 /**
  * @brief handlePseudoClockInterrupt
  *
- * This function handles the pseudo clock interrupt.
- * It loads the system-wide interval timer and unblocks any processes waiting on the pseudo clock semaphore.
+ * This function handles the interval timer interrupt, which is shared by the pseudo clock
+ * and by the releases of the periodic processes.
+ * If the pseudo clock tick is due it unblocks any processes waiting on the pseudo clock semaphore,
+ * then it starts the new period of the periodic processes whose release time has come.
+ * The interval timer is programmed again only for the events still pending.
  * It then checks if the current process is null and either schedules or loads the state of the current process.
  *  
  * @details
- *   - It acquires the global lock to ensure mutual exclusion.
- *   - It loads the system-wide interval timer.
- *   - It retrieves the pseudo clock semaphore address.
- *   - It unblocks any processes waiting on the pseudo clock semaphore.
+ *   - It acquires the AslLock (for the pseudo clock semaphore) and the ClockLock.
+ *   - If the tick is due, it records it and unblocks any processes waiting on the pseudo clock semaphore.
+ *   - It releases the periodic processes whose next period has started.
+ *   - It reprograms (or parks) the interval timer, which acknowledges the interrupt.
  *   - It checks if the current process is null.
  *   - If it is, it releases the lock and calls the scheduler.
- *   - If it is not, it releases the lock and loads the state of the current process.
+ *   - If it is not, it releases the lock and loads the state of the current process
+ *     (or gives the CPU to a released periodic process, see _returnFromInterrupt).
  */
 void handlePseudoClockInterrupt() {
-  ACQUIRE_LOCK(&GlobalLock);
-  LDIT(PSECOND); // load the system wide interval timer
-  
-  int* semAddr = getPseudoClockSemaphore();
-  
-  pcb_t* unblocked = headBlocked(semAddr);
+  spinLock(&AslLock);
+  spinLock(&ClockLock);
+  cpu_t now;
+  STCK(now);
+  cpu_t period = PSECOND * (*((cpu_t*)TIMESCALEADDR));
+
+  if (PseudoClockArmed && !TOD_BEFORE(now, PseudoClockTOD + period)) {
+    PseudoClockTOD += period;
+    PseudoClockArmed = 0;
+
+    int* semAddr = getPseudoClockSemaphore();
+    pcb_t* unblocked;
 
-  if(unblocked){
     while ((unblocked = removeBlocked(semAddr))) {
-      insertProcQ(&ReadyQueue, unblocked);
+      readyInsert(unblocked);
     }
   }
-  RELEASE_LOCK(&GlobalLock);
 
-  if (!CurrentProcess[getPRID()]) {
-    scheduler();
-  } else {
-    LDST(&CurrentProcess[getPRID()]->p_s);
-  }
+  edfRelease(now);
+  intervalTimerUpdate();
+  spinUnlock(&ClockLock);
+  spinUnlock(&AslLock);
+
+  _returnFromInterrupt();
+}
+
+/**
+ * @brief handleIPIInterrupt
+ *
+ * This function handles an inter-processor interrupt.
+ * IPIs are sent by readyInsert to wake up an idle CPU: after the acknowledgement
+ * the CPU goes back to the scheduler, which finds the new runnable process.
+ * If a process was running (the CPU stopped being idle before the IPI arrived)
+ * it is simply resumed.
+ */
+void handleIPIInterrupt() {
+  *((memaddr*)INBOX) = ACK;
+
+  _returnFromInterrupt();
 }
 
 /**
@@ -303,6 +525,9 @@ void handlePseudoClockInterrupt() {
  */
 void INTERRUPT_handler() {
   switch (getLineNo()) {
+    case 0:
+      handleIPIInterrupt();
+      break;
     case 1:
       handleProcessLocalTimerInterrupt();
       break;
@@ -1,6 +1,6 @@
 /**
  * ==========================================================================
- * |                              SCHEDULER                                 |                       
+ * |                              SCHEDULER                                 |
  * ==========================================================================
  * @file scheduler.c
  *
@@ -11,9 +11,35 @@
  * It handles the process dispatching and waiting for processes.
  *
  * @details
+ * - Every CPU owns a ready queue protected by its own lock (ReadyQueue[cpu]).
  * - The scheduler function is called when a process needs to be scheduled.
- * - It checks if the ready queue is empty and either halts or waits for processes.
- * - If there are processes in the ready queue, it dispatches the next process.
+ * - Each ready queue keeps one FIFO per queue level and a bitmap of the
+ *   non-empty ones, so the next process is found in constant time.
+ * - PROCESS_PRIO_HIGH processes live in the topmost level; PROCESS_PRIO_LOW
+ *   processes are scheduled by a multi-level feedback queue (MLFQ): a process
+ *   that uses up its time slice is demoted to a lower level with a longer
+ *   slice, a process that blocks is promoted, and every MLFQ_BOOST all the
+ *   processes are brought back to the highest feedback level.
+ * - It dispatches the next process of the local ready queue and, only when
+ *   that is empty, steals a process from the queue of another CPU.
+ * - Periodic processes (SETPERIODIC) form an earliest-deadline-first class,
+ *   shared by all the CPUs and always scheduled ahead of the ready queues;
+ *   the PLT is armed with their remaining budget, and a process that uses it
+ *   up waits for its next period.
+ * - If no process is runnable anywhere it either halts or waits for processes.
+ * - Every CPU accounts its own time (CpuStats): the dispatch starts the
+ *   charging interval of the process, waiting adds to the idle time.
+ * - Every BALANCE_INTERVAL a balancing pass, run off the PLT interrupt, moves
+ *   a batch of processes from the busiest to the least loaded CPU; its
+ *   counters are kept in BalanceStats.
+ * - Idle CPUs are tracked in IdleCpus: making a process runnable sends an
+ *   inter-processor interrupt to exactly one of them, which wakes up from
+ *   WAIT() and steals the process right away.
+ * - Building with SCHED_POLICY set to SCHED_FAIR replaces the MLFQ with a
+ *   completely-fair policy: each ready queue is a red-black tree ordered by
+ *   virtual runtime and the process that ran least is always picked next.
+ * - Building with PERCPU_READYQUEUE set to 0 maps every CPU on queue 0,
+ *   which gives back the single shared ready queue (used as a baseline).
  */
 
 #include <uriscv/const.h>
@@ -21,40 +47,996 @@
 #include <uriscv/types.h>
 #include "./headers/scheduler.h"
 
-/** 
+#if PERCPU_READYQUEUE
+#define RQ_OF(cpu) (&ReadyQueue[(cpu)])
+#else
+#define RQ_OF(cpu) (&ReadyQueue[0])
+#endif
+
+/* CPUs parked in WAIT(): bit i is set while CPU i has nothing to run */
+static unsigned int IdleCpus;
+static spinlock_t IdleLock;
+
+/* load balancer: TOD of the last pass, the lock makes sure only one CPU balances at a time */
+static cpu_t LastBalanceTOD;
+static spinlock_t BalanceLock;
+
+/*
+ * EDF real-time class, shared by all the CPUs and scheduled ahead of the ready queues.
+ * EdfReady holds the runnable periodic processes ordered by deadline, EdfSleeping
+ * the ones waiting for their next period ordered by release time (their p_deadline).
+ * EdfReadyCount and EdfFirstDeadline (the deadline at the head of EdfReady) are
+ * updated under EdfLock and read without it by readyShouldPreempt.
+ */
+static struct list_head EdfReady;
+static struct list_head EdfSleeping;
+static volatile unsigned int EdfReadyCount;
+static volatile cpu_t EdfFirstDeadline;
+static spinlock_t EdfLock;
+
+/**
+ * @brief Returns the index of the lowest bit set in a non-zero word.
+ *
+ * Uses a de Bruijn sequence so that it costs a multiplication and a table
+ * lookup whatever the word is (rv32 has no count-trailing-zeros instruction).
+ */
+static inline int _lowestBit(unsigned int word) {
+  static const unsigned char debruijn[32] = {
+    0,  1,  28, 2,  29, 14, 24, 3,  30, 22, 20, 15, 25, 17, 4,  8,
+    31, 27, 13, 23, 21, 19, 16, 7,  26, 12, 18, 6,  11, 5,  10, 9
+  };
+  return debruijn[((word & -word) * 0x077CB531U) >> 27];
+}
+
+#if SCHED_POLICY == SCHED_FAIR
+
+/* virtual runtimes grow without bound: compare them as TOD_BEFORE does, across the wraparound */
+#define VRUNTIME_BEFORE(a, b) ((int)((unsigned int)(a) - (unsigned int)(b)) < 0)
+
+/**
+ * @brief Returns the time slice of p.
+ */
+static inline cpu_t _sliceOf(pcb_t* p) {
+  return TIMESLICE;
+}
+
+/**
+ * @brief Inserts p in the tree of rq, ordered by p_vruntime. The lock of rq must be held.
+ *
+ * @details
+ *  - The CPU time charged to p_time since the last enqueue is added to the
+ *    virtual runtime, at half rate for PROCESS_PRIO_HIGH processes.
+ *  - The virtual runtime is moved from the time scale of the queue p left
+ *    (p_vbase, see _unlink) to the one of rq, keeping its lead or lag on the
+ *    other processes: a process moved between queues by a steal, a migration
+ *    or an affinity change is neither favoured nor penalized.
+ *  - A process that was blocked (or is new) restarts from the minimum virtual
+ *    runtime of the queue, so it cannot monopolize the CPU to catch up.
+ *  - Equal keys go to the right, which keeps FIFO order among them.
+ */
+static inline void _enqueue(readyq_t* rq, pcb_t* p) {
+  cpu_t used = p->p_time - p->p_dispatchTime;
+  p->p_vruntime += (p->p_prio == PROCESS_PRIO_HIGH) ? (used >> 1) : used;
+  p->p_dispatchTime = p->p_time;
+
+  p->p_vruntime = p->p_vruntime - p->p_vbase + rq->rq_minVruntime;
+  p->p_vbase = rq->rq_minVruntime;
+  if (VRUNTIME_BEFORE(p->p_vruntime, rq->rq_minVruntime)) {
+    p->p_vruntime = rq->rq_minVruntime;
+  }
+
+  struct rb_node** link = &rq->rq_tree.rb_node;
+  struct rb_node* parent = NULL;
+  int leftmost = 1;
+  while (*link) {
+    parent = *link;
+    if (VRUNTIME_BEFORE(p->p_vruntime, rb_entry(parent, pcb_t, p_node)->p_vruntime)) {
+      link = &parent->rb_left;
+    } else {
+      link = &parent->rb_right;
+      leftmost = 0;
+    }
+  }
+
+  rb_link_node(&p->p_node, parent, link);
+  rb_insert_color(&p->p_node, &rq->rq_tree);
+  if (leftmost) rq->rq_leftmost = &p->p_node;
+  rq->rq_count++;
+}
+
+/**
+ * @brief Unlinks the node of p from the tree of rq. The lock of rq must be held.
+ *
+ * p_vbase records the time scale of rq, which _enqueue moves p from.
+ */
+static inline void _unlink(readyq_t* rq, pcb_t* p) {
+  if (rq->rq_leftmost == &p->p_node) rq->rq_leftmost = rb_next(&p->p_node);
+  rb_erase(&p->p_node, &rq->rq_tree);
+  p->p_vbase = rq->rq_minVruntime;
+
+  // a detached node is its own root: see _remove
+  p->p_node.rb_parent = NULL;
+  p->p_node.rb_left = NULL;
+  p->p_node.rb_right = NULL;
+  rq->rq_count--;
+}
+
+/**
+ * @brief Removes the process with the smallest virtual runtime that may run on cpu.
+ * The lock of rq must be held.
+ */
+static inline pcb_t* _dequeueFor(readyq_t* rq, int cpu) {
+  for (struct rb_node* n = rq->rq_leftmost; n; n = rb_next(n)) {
+    pcb_t* p = rb_entry(n, pcb_t, p_node);
+    if (!(p->p_affinity & (1U << cpu))) continue;
+
+    if (n == rq->rq_leftmost && VRUNTIME_BEFORE(rq->rq_minVruntime, p->p_vruntime)) {
+      rq->rq_minVruntime = p->p_vruntime;
+    }
+    _unlink(rq, p);
+    return p;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Removes p from rq if it is queued there. The lock of rq must be held.
+ *
+ * p belongs to rq iff climbing its parents leads to the root of rq.
+ *
+ * @return 1 if p was removed, 0 otherwise.
+ */
+static inline int _remove(readyq_t* rq, pcb_t* p) {
+  struct rb_node* n = &p->p_node;
+  while (n->rb_parent) n = n->rb_parent;
+  if (n != rq->rq_tree.rb_node) return 0;
+
+  _unlink(rq, p);
+  return 1;
+}
+
+static inline void _initQueue(readyq_t* rq) {
+  rq->rq_tree.rb_node = NULL;
+  rq->rq_leftmost = NULL;
+  rq->rq_minVruntime = 0;
+}
+
+/**
+ * @brief Tells whether the first process of rq ran sufficiently less than curr.
+ *
+ * CFS_WAKEUP_GRAN avoids switching back and forth between processes whose
+ * virtual runtimes are almost equal. curr may come from another queue (a
+ * steal), so both are compared as a lag on the minimum of their own queue.
+ */
+static inline int _shouldPreempt(readyq_t* rq, pcb_t* curr) {
+  struct rb_node* first = rq->rq_leftmost;
+  return first && VRUNTIME_BEFORE(rb_entry(first, pcb_t, p_node)->p_vruntime - rq->rq_minVruntime + CFS_WAKEUP_GRAN,
+                                  curr->p_vruntime - curr->p_vbase);
+}
+
+#else
+
+/* bit of rq_bitmap associated to a queue level: the highest level gets bit 0 */
+#define LEVEL_BIT(q) (1U << (NPRIO - 1 - (q)))
+
+/* MLFQ boost state: processes whose p_boostEpoch is older than BoostEpoch are back to level 0 */
+static unsigned int BoostEpoch;
+static cpu_t LastBoostTOD;
+static spinlock_t BoostLock;
+
+/**
+ * @brief Returns the highest queue level with a runnable process in rq, -1 if rq is empty.
+ */
+static inline int _topQueue(readyq_t* rq) {
+  if (!rq->rq_bitmap) return -1;
+  return NPRIO - 1 - _lowestBit(rq->rq_bitmap);
+}
+
+/**
+ * @brief Returns the queue level of p: NPRIO - 1 for PROCESS_PRIO_HIGH, the MLFQ level otherwise.
+ */
+static inline int _queueOf(pcb_t* p) {
+  if (p->p_prio == PROCESS_PRIO_HIGH) return NPRIO - 1;
+  return MLFQ_LEVELS - 1 - p->p_level;
+}
+
+/**
+ * @brief Returns the time slice of p: TIMESLICE doubled for every MLFQ level below the first.
+ */
+static inline cpu_t _sliceOf(pcb_t* p) {
+  if (p->p_prio == PROCESS_PRIO_HIGH) return TIMESLICE;
+  return TIMESLICE << p->p_level;
+}
+
+/**
+ * @brief Appends p to the queue of its level. The lock of rq must be held.
+ */
+static inline void _enqueue(readyq_t* rq, pcb_t* p) {
+  // a boost happened while p was not in a ready queue
+  if (p->p_boostEpoch != BoostEpoch) {
+    p->p_level = 0;
+    p->p_boostEpoch = BoostEpoch;
+  }
+
+  int q = _queueOf(p);
+  insertProcQ(&rq->rq_procq[q], p);
+  rq->rq_bitmap |= LEVEL_BIT(q);
+  rq->rq_count++;
+}
+
+/**
+ * @brief Removes the first process of the highest non-empty level that may run on cpu.
+ * The lock of rq must be held.
+ *
+ * Processes queued on their own CPU always satisfy their affinity, so the
+ * scan only goes past the head of a level when another CPU is stealing.
+ */
+static inline pcb_t* _dequeueFor(readyq_t* rq, int cpu) {
+  unsigned int bitmap = rq->rq_bitmap;
+
+  while (bitmap) {
+    int q = NPRIO - 1 - _lowestBit(bitmap);
+    struct list_head* iter;
+    list_for_each(iter, &rq->rq_procq[q]) {
+      pcb_t* p = container_of(iter, pcb_t, p_list);
+      if (p->p_affinity & (1U << cpu)) {
+        list_del(iter);
+        if (emptyProcQ(&rq->rq_procq[q])) rq->rq_bitmap &= ~LEVEL_BIT(q);
+        rq->rq_count--;
+        return p;
+      }
+    }
+    bitmap &= ~LEVEL_BIT(q);
+  }
+  return NULL;
+}
+
+/**
+ * @brief Removes p from rq if it is queued there. The lock of rq must be held.
+ *
+ * @return 1 if p was removed, 0 otherwise.
+ */
+static inline int _remove(readyq_t* rq, pcb_t* p) {
+  int q = _queueOf(p);
+  if (!outProcQ(&rq->rq_procq[q], p)) return 0;
+
+  if (emptyProcQ(&rq->rq_procq[q])) rq->rq_bitmap &= ~LEVEL_BIT(q);
+  rq->rq_count--;
+  return 1;
+}
+
+static inline void _initQueue(readyq_t* rq) {
+  for (int q = 0; q < NPRIO; q++) {
+    mkEmptyProcQ(&rq->rq_procq[q]);
+  }
+  rq->rq_bitmap = 0;
+}
+
+/**
+ * @brief Tells whether rq holds a process with a higher queue level than curr.
+ *
+ * Only the bitmap is read, so the check needs no lock and costs constant time.
+ */
+static inline int _shouldPreempt(readyq_t* rq, pcb_t* curr) {
+  return _topQueue(rq) > _queueOf(curr);
+}
+
+/**
+ * @brief Brings every PROCESS_PRIO_LOW process back to the highest MLFQ level.
+ *
+ * Queued processes are moved right away; all the others (running or blocked)
+ * are boosted lazily by _enqueue, because their p_boostEpoch is now stale.
+ */
+static void _boost(void) {
+  BoostEpoch++;
+
+  for (int i = 0; i < NCPU; i++) {
+    readyq_t* rq = &ReadyQueue[i];
+    struct list_head* top = &rq->rq_procq[MLFQ_LEVELS - 1];
+
+    spinLock(&rq->rq_lock);
+    for (int q = 0; q < MLFQ_LEVELS - 1; q++) {
+      pcb_t* p;
+      while ((p = removeProcQ(&rq->rq_procq[q]))) {
+        p->p_level = 0;
+        p->p_boostEpoch = BoostEpoch;
+        insertProcQ(top, p);
+      }
+      rq->rq_bitmap &= ~LEVEL_BIT(q);
+    }
+    if (!emptyProcQ(top)) rq->rq_bitmap |= LEVEL_BIT(MLFQ_LEVELS - 1);
+    spinUnlock(&rq->rq_lock);
+  }
+}
+
+#endif
+
+/**
+ * @brief Initializes the ready queues of all the CPUs and the EDF class.
+ */
+void initReadyQueues(void) {
+  for (int i = 0; i < NCPU; i++) {
+    _initQueue(&ReadyQueue[i]);
+    spinInit(&ReadyQueue[i].rq_lock);
+    ReadyQueue[i].rq_count = 0;
+  }
+
+  INIT_LIST_HEAD(&EdfReady);
+  INIT_LIST_HEAD(&EdfSleeping);
+  EdfReadyCount = 0;
+  spinInit(&EdfLock);
+
+  STCK(LastBalanceTOD);
+  spinInit(&BalanceLock);
+  BalanceStats.bs_runs = 0;
+  BalanceStats.bs_migrations = 0;
+  BalanceStats.bs_migrationsPerSec = 0;
+  BalanceStats.bs_imbalance = 0;
+  BalanceStats.bs_maxImbalance = 0;
+  BalanceStats.bs_windowStart = LastBalanceTOD;
+  BalanceStats.bs_windowMigrations = 0;
+}
+
+/**
+ * @brief Marks cpu as idle or busy in IdleCpus.
+ */
+static inline void _setIdle(int cpu, int idle) {
+  spinLock(&IdleLock);
+  if (idle) {
+    IdleCpus |= (1U << cpu);
+  } else {
+    IdleCpus &= ~(1U << cpu);
+  }
+  spinUnlock(&IdleLock);
+}
+
+// how an IPI is sent: written to OUTBOX on uriscv (see host/CMakeLists.txt for the host build)
+#ifndef SEND_IPI
+#define SEND_IPI(word) (*((memaddr*)OUTBOX) = (word))
+#endif
+
+/**
+ * @brief Wakes up one idle CPU, if there is any, with an IPI.
+ *
+ * The CPU is removed from IdleCpus by the sender, so that two wakeups
+ * happening together kick two different CPUs.
+ *
+ * @param home The CPU whose ready queue received the process: it is preferred if idle.
+ * @param allowed The CPUs the process may run on.
+ */
+static inline void _kickIdleCpu(int home, unsigned int allowed) {
+  if (!(IdleCpus & allowed)) return;
+
+  int target = -1;
+  spinLock(&IdleLock);
+  if (IdleCpus & (1U << home)) {
+    target = home;
+  } else if (IdleCpus & allowed) {
+    target = _lowestBit(IdleCpus & allowed);
+  }
+  if (target >= 0) IdleCpus &= ~(1U << target);
+  spinUnlock(&IdleLock);
+
+  if (target >= 0) {
+    SEND_IPI((1U << (target + IPI_RECIPIENTS_SHIFT)) | IPI_WAKEUP);
+  }
+}
+
+/**
+ * @brief Sends an IPI to cpu: if its current process has been taken away
+ * (CurrentProcess[cpu] is NULL) the CPU goes back to the scheduler.
+ */
+void schedKick(int cpu) {
+  SEND_IPI((1U << (cpu + IPI_RECIPIENTS_SHIFT)) | IPI_WAKEUP);
+}
+
+/**
+ * @brief Chooses the CPU whose ready queue p goes to.
+ *
+ * @details
+ *  - The CPU p last ran on, if its affinity still allows it: its TLB and
+ *    caches may still hold p's working set.
+ *  - Otherwise the calling CPU, if allowed.
+ *  - Otherwise the first CPU of the affinity mask.
+ */
+static inline int _placeCpu(pcb_t* p, int cpu) {
+  if (p->p_lastCpu >= 0 && (p->p_affinity & (1U << p->p_lastCpu))) return p->p_lastCpu;
+  if (p->p_affinity & (1U << cpu)) return cpu;
+  return _lowestBit(p->p_affinity);
+}
+
+/**
+ * @brief Inserts p in list, keeping it ordered by p_deadline. The lock EdfLock must be held.
+ *
+ * Equal deadlines keep FIFO order.
+ */
+static inline void _edfInsert(struct list_head* list, pcb_t* p) {
+  struct list_head* iter;
+  list_for_each(iter, list) {
+    if (TOD_BEFORE(p->p_deadline, container_of(iter, pcb_t, p_list)->p_deadline)) break;
+  }
+  list_add_tail(&p->p_list, iter);
+}
+
+/**
+ * @brief Removes p from list if it is there. The lock EdfLock must be held.
+ *
+ * @return 1 if p was removed, 0 otherwise.
+ */
+static inline int _edfUnlink(struct list_head* list, pcb_t* p) {
+  struct list_head* iter;
+  list_for_each(iter, list) {
+    if (iter == &p->p_list) {
+      list_del(iter);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Charges to the budget of p the CPU time it used since the last charge.
+ */
+static inline void _edfCharge(pcb_t* p) {
+  cpu_t used = p->p_time - p->p_charged;
+  p->p_budgetLeft = (used >= p->p_budgetLeft) ? 0 : p->p_budgetLeft - used;
+  p->p_charged = p->p_time;
+}
+
+/**
+ * @brief Publishes the deadline at the head of EdfReady, after every change of the list.
+ * The lock EdfLock must be held.
+ */
+static inline void _edfPublish(void) {
+  if (!list_empty(&EdfReady)) {
+    EdfFirstDeadline = container_of(EdfReady.next, pcb_t, p_list)->p_deadline;
+  }
+}
+
+/**
+ * @brief Makes the periodic process p runnable in the EDF class.
+ */
+static inline void _edfMakeReady(pcb_t* p) {
+  p->p_state = PCB_READY;
+  spinLock(&EdfLock);
+  _edfInsert(&EdfReady, p);
+  EdfReadyCount++;
+  _edfPublish();
+  spinUnlock(&EdfLock);
+
+  _kickIdleCpu(_placeCpu(p, getPRID()), p->p_affinity);
+}
+
+/**
+ * @brief Takes the runnable periodic process with the earliest deadline that may run on cpu
+ * and makes it the current process of cpu.
+ */
+static inline pcb_t* _edfTake(int cpu) {
+  if (EdfReadyCount == 0) return NULL;
+
+  pcb_t* taken = NULL;
+  spinLock(&EdfLock);
+  struct list_head* iter;
+  list_for_each(iter, &EdfReady) {
+    pcb_t* p = container_of(iter, pcb_t, p_list);
+    if (p->p_affinity & (1U << cpu)) {
+      list_del(iter);
+      EdfReadyCount--;
+      _edfPublish();
+      CurrentProcess[cpu] = p; // now it's running
+      p->p_lastCpu = cpu;
+      p->p_state = PCB_RUNNING;
+      taken = p;
+      break;
+    }
+  }
+  spinUnlock(&EdfLock);
+  return taken;
+}
+
+/**
+ * @brief Registers the current process p as periodic, or turns it back into a normal process.
+ *
+ * The first period starts now. There is no admission test: when the periodic
+ * processes ask for more than NCPU CPUs' worth of budget they miss deadlines,
+ * and WAITPERIOD reports it.
+ *
+ * @param p The process, which must not be in any queue.
+ * @param period The period in microseconds, 0 to leave the real-time class.
+ * @param budget The CPU time granted in every period, in microseconds.
+ * @return 0 on success, -1 if the budget is 0 or longer than the period.
+ */
+int edfSetPeriodic(pcb_t* p, unsigned int period, unsigned int budget) {
+  if (period == 0) {
+    p->p_period = 0;
+    return 0;
+  }
+  if (budget == 0 || budget > period) return -1;
+
+  cpu_t timescale = *((cpu_t*)TIMESCALEADDR);
+  cpu_t now;
+  STCK(now);
+
+  p->p_period = period * timescale;
+  p->p_budget = budget * timescale;
+  p->p_budgetLeft = p->p_budget;
+  p->p_deadline = now + p->p_period;
+  p->p_charged = p->p_time;
+  p->p_missed = 0;
+  return 0;
+}
+
+/**
+ * @brief Suspends the periodic process p until its next period.
+ *
+ * Called when p has used up its budget (from the PLT handler) or has finished
+ * the job of the current period (WAITPERIOD). A job that is finished after its
+ * deadline is counted as a missed deadline, and so is a job that ran out of
+ * budget: it cannot run again before the next period, so it is bound to miss,
+ * and it is counted now, even if the deadline has not come yet.
+ * The interval timer must then be reprogrammed with edfNextRelease.
+ *
+ * @param p The process, which must not be in any queue.
+ * @param done 1 if the job of the period is finished, 0 if the budget ran out.
+ * @param now The current TOD.
+ */
+void edfSuspend(pcb_t* p, int done, cpu_t now) {
+  _edfCharge(p);
+
+  if (!done || !TOD_BEFORE(now, p->p_deadline)) {
+    p->p_missed++;
+  }
+
+  if (!TOD_BEFORE(now, p->p_deadline)) {
+    // the period is already over: start the next one right away
+    p->p_deadline = now + p->p_period;
+    p->p_budgetLeft = p->p_budget;
+    _edfMakeReady(p);
+    return;
+  }
+
+  p->p_state = PCB_BLOCKED;
+  spinLock(&EdfLock);
+  _edfInsert(&EdfSleeping, p);
+  spinUnlock(&EdfLock);
+}
+
+/**
+ * @brief Starts the new period of every sleeping periodic process whose release time has come.
+ *
+ * @param now The current TOD.
+ */
+void edfRelease(cpu_t now) {
+  spinLock(&EdfLock);
+  while (!list_empty(&EdfSleeping)) {
+    pcb_t* p = container_of(EdfSleeping.next, pcb_t, p_list);
+    if (TOD_BEFORE(now, p->p_deadline)) break;
+
+    list_del(&p->p_list);
+    p->p_deadline += p->p_period;
+    p->p_budgetLeft = p->p_budget;
+    p->p_state = PCB_READY;
+    _edfInsert(&EdfReady, p);
+    EdfReadyCount++;
+    _edfPublish();
+    spinUnlock(&EdfLock);
+
+    _kickIdleCpu(_placeCpu(p, getPRID()), p->p_affinity);
+    spinLock(&EdfLock);
+  }
+  spinUnlock(&EdfLock);
+}
+
+/**
+ * @brief Returns the earliest release time among the sleeping periodic processes.
+ *
+ * @param release Where the release time is stored.
+ * @return 1 if some process is sleeping, 0 otherwise.
+ */
+int edfNextRelease(cpu_t* release) {
+  int any = 0;
+
+  spinLock(&EdfLock);
+  if (!list_empty(&EdfSleeping)) {
+    *release = container_of(EdfSleeping.next, pcb_t, p_list)->p_deadline;
+    any = 1;
+  }
+  spinUnlock(&EdfLock);
+  return any;
+}
+
+/**
+ * @brief Makes a process runnable.
+ *
+ * The process is appended to the ready queue of the CPU it last ran on
+ * (see _placeCpu), so that it finds its TLB entries and cache lines warm.
+ * If its CPU, or another CPU it may run on, is idle it is woken up.
+ * Periodic processes go to the EDF class instead, charging to their budget
+ * the time they used.
+ *
+ * @param p The process to insert.
+ */
+void readyInsert(pcb_t* p) {
+  if (p->p_period) {
+    _edfCharge(p);
+    _edfMakeReady(p);
+    return;
+  }
+
+  int home = _placeCpu(p, getPRID());
+  readyq_t* rq = RQ_OF(home);
+
+  p->p_state = PCB_READY;
+  spinLock(&rq->rq_lock);
+  _enqueue(rq, p);
+  p->p_rq = rq;
+  spinUnlock(&rq->rq_lock);
+
+  _kickIdleCpu(home, p->p_affinity);
+}
+
+/**
+ * @brief Removes a process from the ready queue it is in, if any.
+ *
+ * A periodic process is also removed while it waits for its next period.
+ * The balancer may move p to another queue at any time (see _migrate), so
+ * p_rq is checked again once the lock of the queue it names is held: if p
+ * has moved meanwhile, its new queue is tried.
+ *
+ * @param p The process to remove.
+ * @return p if it was found in a ready queue, NULL otherwise.
+ */
+pcb_t* readyRemove(pcb_t* p) {
+  if (p->p_period) {
+    spinLock(&EdfLock);
+    int removed = _edfUnlink(&EdfSleeping, p);
+    if (!removed && _edfUnlink(&EdfReady, p)) {
+      EdfReadyCount--;
+      _edfPublish();
+      removed = 1;
+    }
+    spinUnlock(&EdfLock);
+
+    if (removed) return p;
+  }
+
+  readyq_t* rq;
+  while ((rq = p->p_rq)) {
+    spinLock(&rq->rq_lock);
+    if (p->p_rq == rq) {
+      _remove(rq, p);
+      p->p_rq = NULL;
+      spinUnlock(&rq->rq_lock);
+      return p;
+    }
+    spinUnlock(&rq->rq_lock);
+  }
+  return NULL;
+}
+
+/**
+ * @brief Tells whether the local ready queue holds a process that should preempt curr.
+ *
+ * A runnable periodic process preempts any normal process and the periodic
+ * processes with a later deadline.
+ * The check is done without taking the lock, on the words published under EdfLock
+ * (no PCB of the EDF class is touched): a stale answer only delays or
+ * anticipates a preemption that the next time slice expiry would do anyway.
+ *
+ * @param curr The process currently running on the calling CPU.
+ * @return 1 if curr should give the CPU to a waiting process, 0 otherwise.
+ */
+int readyShouldPreempt(pcb_t* curr) {
+  if (EdfReadyCount) {
+    if (!curr->p_period || TOD_BEFORE(EdfFirstDeadline, curr->p_deadline)) return 1;
+  }
+  if (curr->p_period) return 0;
+
+  return _shouldPreempt(RQ_OF(getPRID()), curr);
+}
+
+/**
+ * @brief Called when p has used up its whole time slice.
+ *
+ * With the MLFQ policy a PROCESS_PRIO_LOW process is demoted by one level
+ * (longer slice, lower priority). This is also where the periodic boost is triggered: slices expire
+ * only while processes compete for the CPUs, which is when starvation can happen.
+ *
+ * @param p The process whose slice expired.
+ */
+void schedSliceExpired(pcb_t* p) {
+#if SCHED_POLICY != SCHED_FAIR
+  if (p->p_prio != PROCESS_PRIO_HIGH && p->p_level < MLFQ_LEVELS - 1) {
+    p->p_level++;
+  }
+
+  cpu_t now;
+  STCK(now);
+  if (now - LastBoostTOD >= MLFQ_BOOST) {
+    spinLock(&BoostLock);
+    if (now - LastBoostTOD >= MLFQ_BOOST) {
+      LastBoostTOD = now;
+      _boost();
+    }
+    spinUnlock(&BoostLock);
+  }
+#endif
+}
+
+/**
+ * @brief Called when p blocks on a semaphore or on a DOIO before its slice expired.
+ *
+ * With the MLFQ policy the process is promoted by one level, so that interactive processes
+ * get back quickly to the CPU when they are woken up.
+ *
+ * @param p The process that is blocking.
+ */
+void schedBlocked(pcb_t* p) {
+#if SCHED_POLICY != SCHED_FAIR
+  if (p->p_level > 0) {
+    p->p_level--;
+  }
+#endif
+}
+
+#if PERCPU_READYQUEUE
+/**
+ * @brief Returns the runnable load of cpu: its queued processes plus the running one.
+ *
+ * Read without locks, the balancer only needs an estimate.
+ */
+static inline unsigned int _loadOf(int cpu) {
+  return ReadyQueue[cpu].rq_count + (CurrentProcess[cpu] != NULL);
+}
+
+/**
+ * @brief Moves at most n processes that may run on the CPU to from the ready queue of the CPU from to the one of to.
+ *
+ * The two queue locks are taken in CPU order, so two balancing passes (or a
+ * pass and anything else holding a single queue lock) can never deadlock.
+ * p_rq goes from src to dst while both are held (see readyRemove).
+ *
+ * @return The number of processes moved.
+ */
+static int _migrate(int from, int to, int n) {
+  readyq_t* src = &ReadyQueue[from];
+  readyq_t* dst = &ReadyQueue[to];
+  readyq_t* first = (from < to) ? src : dst;
+  readyq_t* second = (from < to) ? dst : src;
+  int moved = 0;
+  pcb_t* p;
+
+  spinLock(&first->rq_lock);
+  spinLock(&second->rq_lock);
+  while (moved < n && (p = _dequeueFor(src, to))) {
+    _enqueue(dst, p);
+    p->p_rq = dst;
+    moved++;
+  }
+  spinUnlock(&second->rq_lock);
+  spinUnlock(&first->rq_lock);
+
+  return moved;
+}
+
+/**
+ * @brief One balancing pass: moves half of the load difference between the
+ * busiest and the idlest CPU (at most BALANCE_BATCH processes) in one batch.
+ *
+ * @param now The current TOD, used for the migrations per second counter.
+ */
+static void _balance(cpu_t now) {
+  int busiest = 0, idlest = 0;
+
+  for (int i = 0; i < NCPU; i++) {
+    BalanceStats.bs_load[i] = _loadOf(i);
+    if (BalanceStats.bs_load[i] > BalanceStats.bs_load[busiest]) busiest = i;
+    if (BalanceStats.bs_load[i] < BalanceStats.bs_load[idlest]) idlest = i;
+  }
+
+  unsigned int imbalance = BalanceStats.bs_load[busiest] - BalanceStats.bs_load[idlest];
+  BalanceStats.bs_runs++;
+  BalanceStats.bs_imbalance = imbalance;
+  if (imbalance > BalanceStats.bs_maxImbalance) BalanceStats.bs_maxImbalance = imbalance;
+
+  // a difference of one process cannot be improved by moving it
+  if (imbalance >= 2) {
+    int batch = imbalance / 2;
+    if (batch > BALANCE_BATCH) batch = BALANCE_BATCH;
+
+    int moved = _migrate(busiest, idlest, batch);
+    if (moved) {
+      BalanceStats.bs_migrations += moved;
+      BalanceStats.bs_windowMigrations += moved;
+      _kickIdleCpu(idlest, 1U << idlest);
+    }
+  }
+
+  if (now - BalanceStats.bs_windowStart >= SECOND * (*((cpu_t*)TIMESCALEADDR))) {
+    BalanceStats.bs_migrationsPerSec = BalanceStats.bs_windowMigrations;
+    BalanceStats.bs_windowMigrations = 0;
+    BalanceStats.bs_windowStart = now;
+  }
+}
+#endif
+
+/**
+ * @brief Runs the load balancer if BALANCE_INTERVAL has passed since its last pass.
+ *
+ * Called from the PLT interrupt, so balancing happens only while processes
+ * compete for the CPUs. Idle CPUs already steal work one process at a time:
+ * the balancer moves whole batches toward CPUs that are running but have a
+ * shorter queue, before the difference grows into idle time.
+ * Only one CPU balances at a time; the others skip the pass.
+ */
+void schedBalance(void) {
+#if PERCPU_READYQUEUE
+  cpu_t now;
+  STCK(now);
+  if (now - LastBalanceTOD < BALANCE_INTERVAL * (*((cpu_t*)TIMESCALEADDR))) return;
+
+  spinLock(&BalanceLock);
+  if (now - LastBalanceTOD >= BALANCE_INTERVAL * (*((cpu_t*)TIMESCALEADDR))) {
+    LastBalanceTOD = now;
+    _balance(now);
+  }
+  spinUnlock(&BalanceLock);
+#endif
+}
+
+/**
+ * @brief Takes the next process of a ready queue that may run on cpu and makes it the current process of cpu.
+ *
+ * The emptiness test on rq_count is done without the lock so that empty queues
+ * are skipped without any bus traffic; it is repeated once the lock is held.
+ *
+ * @param rq The ready queue to take the process from.
+ * @param cpu The CPU that is going to run the process.
+ * @return The dispatched process, NULL if the queue was empty.
+ */
+static inline pcb_t* _takeFrom(readyq_t* rq, int cpu) {
+  if (rq->rq_count == 0) return NULL;
+
+  spinLock(&rq->rq_lock);
+  pcb_t* p = _dequeueFor(rq, cpu);
+  if (p) {
+    p->p_rq = NULL;
+    CurrentProcess[cpu] = p; // now it's running
+    p->p_lastCpu = cpu;
+    p->p_state = PCB_RUNNING;
+  }
+  spinUnlock(&rq->rq_lock);
+  return p;
+}
+
+/**
+ * @brief Starts charging the time of cpu to the process being dispatched.
+ *
+ * If the CPU was idle, the time it spent waiting is added to its idle time.
+ */
+static inline void _startCharging(int cpu) {
+  cpustat_t* cs = &CpuStats[cpu];
+  cpu_t now;
+  STCK(now);
+
+  if (cs->cs_idle) {
+    cs->cs_idleTime += now - cs->cs_idleSince;
+    cs->cs_idle = 0;
+  }
+  cs->cs_chargeTOD = now;
+}
+
+/**
+ * @brief Marks the beginning of an idle period of cpu (a no-op if it is already idle).
+ */
+static inline void _startIdling(int cpu) {
+  cpustat_t* cs = &CpuStats[cpu];
+
+  if (!cs->cs_idle) {
+    STCK(cs->cs_idleSince);
+    cs->cs_idle = 1;
+  }
+}
+
+/**
+ * @brief Picks the next process to run on cpu.
+ *
+ * Runnable periodic processes come first, by earliest deadline. Then the
+ * local queue is tried; when it is empty the queues of the other
+ * CPUs are scanned, starting from the next one, and the first runnable
+ * process whose affinity allows cpu is stolen.
+ */
+static inline pcb_t* _pickNext(int cpu) {
+  pcb_t* p = _edfTake(cpu);
+  if (!p) p = _takeFrom(RQ_OF(cpu), cpu);
+
+#if PERCPU_READYQUEUE
+  for (int i = 1; !p && i < NCPU; i++) {
+    p = _takeFrom(RQ_OF((cpu + i) % NCPU), cpu);
+  }
+#endif
+
+  return p;
+}
+
+/**
+ * @brief Dispatches next on the calling CPU right away, with the given time slice.
+ *
+ * Used by the directed YIELD: next, already removed from its ready queue and
+ * made the current process of the CPU (p_state and p_lastCpu included, under the
+ * CPU lock), runs for the rest of the slice of the process that handed it the CPU.
+ *
+ * @param next The process to run.
+ * @param slice The time slice, in TOD ticks.
+ */
+void schedHandoff(pcb_t* next, cpu_t slice) {
+  int cpu = getPRID();
+
+  setTIMER(slice);
+  *((memaddr*)TPR) = 0;
+  _startCharging(cpu);
+
+  LDST(next->p_s);
+}
+
+/**
  * @brief Scheduler function.
  *
  * This function is responsible for managing the process scheduling in the kernel.
- * It checks if the ready queue is empty and either halts or waits for processes.
- * If there are processes in the ready queue, it dispatches the next process.
+ * It checks if the ready queues are empty and either halts or waits for processes.
+ * If there are processes in the ready queues, it dispatches the next process.
+ *
+ * @details
+ *  Before waiting, the CPU is published in IdleCpus and the ready queues are
+ *  checked once more: a process made runnable in the meantime is either seen
+ *  here or its readyInsert sees the idle bit and sends the wakeup IPI.
  */
 void scheduler() {
-  ACQUIRE_LOCK(&GlobalLock);
-  if (emptyProcQ(&ReadyQueue)) {
-    RELEASE_LOCK(&GlobalLock);
+  int cpu = getPRID();
+
+  // the lock of the CPU covers the move of the next process from its queue to CurrentProcess
+  spinLock(&CpuStats[cpu].cs_lock);
+  pcb_t* next = _pickNext(cpu);
+
+  if (!next && ProcessCount != 0) {
+    _setIdle(cpu, 1);
+    next = _pickNext(cpu);
+  }
+  spinUnlock(&CpuStats[cpu].cs_lock);
+
+  if (next) {
+    _setIdle(cpu, 0);
+  }
+
+  if (!next) {
     if (ProcessCount == 0) {
       unsigned int *irt_entry = (unsigned int*) IRT_START;
       for (int i = 0; i < IRT_NUM_ENTRY; i++) {
         *irt_entry = getPRID();
         irt_entry++;
       }
+#if LOCK_PROFILE
+      lockProfileDump();
+#endif
       HALT();
     } else {
+      // idle CPUs have no time slice to enforce: mask and park the local timer
       setMIE(MIE_ALL & ~MIE_MTIE_MASK);
+      setTIMER(TIMER_PARKED);
       unsigned int status = getSTATUS();
       status |= MSTATUS_MIE_MASK;
       setSTATUS(status);
       *((memaddr*)TPR) = 1;
-      
+      _startIdling(cpu);
+
       WAIT();
     }
   } else {
-    CurrentProcess[getPRID()] = removeProcQ(&ReadyQueue); // now it's running
-    setTIMER(TIMESLICE * (*(cpu_t*)TIMESCALEADDR));
+    // a periodic process runs until its budget is used up
+    setTIMER(next->p_period ? next->p_budgetLeft : _sliceOf(next) * (*(cpu_t*)TIMESCALEADDR));
     *((memaddr*)TPR) = 0;
-    
-    RELEASE_LOCK(&GlobalLock);
+    _startCharging(cpu);
 
-    LDST(&CurrentProcess[getPRID()]->p_s);
+    LDST(next->p_s);
   }
 }
@@ -0,0 +1,261 @@
+/**
+ * @file spinlock.c
+ *
+ * @brief Fair kernel spinlocks with contention statistics.
+ *
+ * ACQUIRE_LOCK is a plain test-and-set: under contention any waiting CPU can
+ * win, so one CPU can starve while the others keep taking the lock. Here
+ * ACQUIRE_LOCK only guards the ticket counter for the few instructions needed
+ * to take a ticket; the CPU then waits until sl_serving reaches its ticket,
+ * so the lock is granted in FIFO order.
+ *
+ * The counters are updated by the holder after getting the lock, so they are
+ * protected by the lock itself and can be read from the debugger to see how
+ * contended every kernel lock is.
+ *
+ * With LOCK_PROFILE every spinLock call site also has its own counters of
+ * acquisitions, wait and hold time (in TOD ticks). The same call site can take
+ * different locks (e.g. the cs_lock of any CPU) at the same time, so each CPU
+ * updates only its own slot and lockProfileDump adds them up on shutdown.
+ */
+
+#include "./headers/spinlock.h"
+
+// keeps the compiler from moving the accesses to the protected data across the unlock
+#define COMPILER_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+// what a CPU does while waiting for its ticket: nothing on uriscv (see host/CMakeLists.txt for the host build)
+#ifndef CPU_RELAX
+#define CPU_RELAX()
+#endif
+
+/**
+ * @brief Initializes a spinlock as free, with its counters reset.
+ *
+ * @param lock Pointer to the lock.
+ */
+void spinInit(spinlock_t* lock) {
+  lock->sl_guard = 0;
+  lock->sl_next = 0;
+  lock->sl_serving = 0;
+  lock->sl_acquisitions = 0;
+  lock->sl_contended = 0;
+  lock->sl_spins = 0;
+  lock->sl_maxSpins = 0;
+}
+
+/**
+ * @brief Takes a spinlock, waiting for the CPUs that asked for it earlier.
+ *
+ * @param lock Pointer to the lock.
+ */
+static inline void _ticketLock(spinlock_t* lock) {
+  unsigned int ticket, spins = 0;
+
+  ACQUIRE_LOCK(&lock->sl_guard);
+  ticket = lock->sl_next++;
+  RELEASE_LOCK(&lock->sl_guard);
+
+  while (lock->sl_serving != ticket) {
+    spins++;
+    CPU_RELAX();
+  }
+  COMPILER_BARRIER();
+
+  lock->sl_acquisitions++;
+  if (spins > 0) {
+    lock->sl_contended++;
+    lock->sl_spins += spins;
+    if (spins > lock->sl_maxSpins) {
+      lock->sl_maxSpins = spins;
+    }
+  }
+}
+
+#if LOCK_PROFILE
+
+#define TERMSTATMASK 0xFF
+#define TERMREADY    1
+#define TERMBUSY     3
+#define TERMDONE     5
+
+static lockprof_t* LockSites;        /* list of the call sites that took a lock at least once */
+static unsigned int LockSitesGuard;  /* ACQUIRE_LOCK word protecting LockSites */
+static int LockProfileDumped;
+static volatile int LockProfilePrinted; /* the first caller of lockProfileDump is done */
+
+/**
+ * @brief Takes a spinlock on behalf of a call site, recording how long it waited.
+ *
+ * @param lock Pointer to the lock.
+ * @param site Counters of the call site.
+ */
+void spinLockAt(spinlock_t* lock, lockprof_t* site) {
+  cpu_t start, acquired;
+  unsigned int wait;
+  int cpu = getPRID();
+
+  if (!site->lp_registered) {
+    ACQUIRE_LOCK(&LockSitesGuard);
+    if (!site->lp_registered) {
+      site->lp_next = LockSites;
+      LockSites = site;
+      site->lp_registered = 1;
+    }
+    RELEASE_LOCK(&LockSitesGuard);
+  }
+
+  STCK(start);
+  _ticketLock(lock);
+  STCK(acquired);
+
+  wait = (unsigned int)(acquired - start);
+  site->lp_acquisitions[cpu]++;
+  site->lp_waitTime[cpu] += wait;
+  if (wait > site->lp_maxWait[cpu]) {
+    site->lp_maxWait[cpu] = wait;
+  }
+
+  lock->sl_site = site;
+  lock->sl_cpu = cpu;
+  lock->sl_acquiredTOD = acquired;
+}
+
+#else
+
+void spinLock(spinlock_t* lock) {
+  _ticketLock(lock);
+}
+
+#endif
+
+/**
+ * @brief Releases a spinlock, passing it to the next ticket.
+ *
+ * @param lock Pointer to the lock, held by the caller.
+ */
+void spinUnlock(spinlock_t* lock) {
+#if LOCK_PROFILE
+  cpu_t now;
+
+  STCK(now);
+  lock->sl_site->lp_holdTime[lock->sl_cpu] += (unsigned int)(now - lock->sl_acquiredTOD);
+#endif
+  COMPILER_BARRIER();
+  lock->sl_serving++;
+}
+
+#if LOCK_PROFILE
+
+/**
+ * @brief Writes a character on the profiler terminal, polling its status.
+ *
+ * The command is only written once the ACK of the previous character has
+ * brought the status back to READY, and the ACK only once the status reports
+ * this character transmitted (or an error): a stale status read right after a
+ * write would make the ACK overwrite the command.
+ */
+static void _termPutChar(char c) {
+  volatile termreg_t* term = (volatile termreg_t*)LOCKPROF_TERMADDR;
+  unsigned int status;
+
+  do {
+    status = term->transm_status & TERMSTATMASK;
+  } while (status == TERMBUSY || status == TERMDONE);
+  term->transm_command = PRINTCHR | ((unsigned int)c << 8);
+  do {
+    status = term->transm_status & TERMSTATMASK;
+  } while (status == TERMREADY || status == TERMBUSY);
+  term->transm_command = ACK;
+}
+
+static void _termPutString(const char* s) {
+  while (*s != EOS) {
+    _termPutChar(*s++);
+  }
+}
+
+// writes num in decimal, right aligned in a column of width characters
+static void _termPutNum(unsigned int num, int width) {
+  char digits[10];
+  int n = 0;
+
+  do {
+    digits[n++] = '0' + num % 10;
+    num /= 10;
+  } while (num > 0);
+
+  while (width-- > n) {
+    _termPutChar(' ');
+  }
+  while (n > 0) {
+    _termPutChar(digits[--n]);
+  }
+}
+
+/**
+ * @brief Prints the lock profile on terminal 0: one row per call site with the
+ * acquisitions and the total wait, longest wait and total hold time in TOD ticks.
+ *
+ * Meant for the HALT path of the scheduler, when no other CPU is using the
+ * locks anymore; only the first caller prints. The others wait for it to be
+ * done, since their HALT would stop the machine in the middle of the table.
+ */
+void lockProfileDump(void) {
+  ACQUIRE_LOCK(&LockSitesGuard);
+  if (LockProfileDumped) {
+    RELEASE_LOCK(&LockSitesGuard);
+    while (!LockProfilePrinted) {
+      CPU_RELAX();
+    }
+    return;
+  }
+  LockProfileDumped = 1;
+  RELEASE_LOCK(&LockSitesGuard);
+
+  _termPutString("\nlock profile (TOD ticks)\n");
+  _termPutString("site                       acq      wait   maxwait      hold\n");
+
+  for (lockprof_t* site = LockSites; site != NULL; site = site->lp_next) {
+    unsigned int acq = 0, wait = 0, maxWait = 0, hold = 0;
+    const char* file = site->lp_file;
+    int len = 1; // the ':'
+
+    for (int i = 0; i < NCPU; i++) {
+      acq += site->lp_acquisitions[i];
+      wait += site->lp_waitTime[i];
+      hold += site->lp_holdTime[i];
+      if (site->lp_maxWait[i] > maxWait) {
+        maxWait = site->lp_maxWait[i];
+      }
+    }
+
+    // only the file name, __FILE__ can hold the whole path
+    for (const char* c = site->lp_file; *c != EOS; c++) {
+      if (*c == '/') {
+        file = c + 1;
+      }
+    }
+    for (const char* c = file; *c != EOS; c++) {
+      len++;
+    }
+    for (int line = site->lp_line; line > 0; line /= 10) {
+      len++;
+    }
+
+    _termPutString(file);
+    _termPutChar(':');
+    _termPutNum(site->lp_line, 0);
+    for (; len < 20; len++) {
+      _termPutChar(' ');
+    }
+    _termPutNum(acq, 10);
+    _termPutNum(wait, 10);
+    _termPutNum(maxWait, 10);
+    _termPutNum(hold, 10);
+    _termPutChar('\n');
+  }
+  LockProfilePrinted = 1;
+}
+
+#endif
@@ -18,6 +18,9 @@
 
 #define CHARTRANSM 5
 
+void getTOD(support_t* supp);
+void setPeriodicUProc(unsigned int period, unsigned int budget, support_t* supp);
+void waitPeriodUProc(support_t* supp);
 void terminateUProc(support_t* supp);
 void writePrinter(char* virtAddr, int len, support_t* supp);
 void writeTerminal(char* virtAddr, int len, support_t* supp);
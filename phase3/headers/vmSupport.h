@@ -13,9 +13,6 @@
 #include "../../phase1/headers/pcb.h"
 #include "../../phase1/headers/asl.h"
 
-#define SWAP_POOL_SIZE 2 * UPROCMAX
-#define SWAP_POOL_STARTADDR (RAMSTART + (64 * PAGESIZE) + (NCPU * PAGESIZE))
-
 #define GET_PAGE_INDEX(vpn) (vpn == 0xBFFFF ? USERPGTBLSIZE - 1 : (vpn & 0xFF))
 
 #define OFFSET_DATA0 0x8
@@ -23,6 +20,16 @@
 
 #define GET_DEV_BASE(int_line, dev_num) (START_DEVREG + ((int_line - 3) * 0x80) + ((dev_num) * 0x10))
 
+/*
+ * The kernel passes an exception up with LDCXT, which starts the handler with the stack
+ * pointer set to the top of sup_stackTLB or sup_stackGen (see _initSupport). On RISC-V the
+ * frame address of a function is the stack pointer at its entry, so the handler gets its
+ * support structure from that register instead of a GETSUPPORTPTR syscall.
+ * Only valid in the function the kernel jumps to.
+ */
+#define SUPPORT_FROM_STACK(stack) \
+  container_of((unsigned int*)__builtin_frame_address(0), support_t, stack[SUPSTACKTOP])
+
 void initSwapStructs(void);
 void TLB_Handler(void);
 
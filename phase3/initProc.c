@@ -69,11 +69,11 @@ static inline void _initSupport(support_t* supp, int asid) {
 
   supp->sup_exceptContext[GENERALEXCEPT].pc = (memaddr)generalExceptionHandler;
   supp->sup_exceptContext[GENERALEXCEPT].status = IEPON | IMON | TEBITON;
-  supp->sup_exceptContext[GENERALEXCEPT].stackPtr = (memaddr)&(supp->sup_stackGen[499]);
+  supp->sup_exceptContext[GENERALEXCEPT].stackPtr = (memaddr)&(supp->sup_stackGen[SUPSTACKTOP]);
 
   supp->sup_exceptContext[PGFAULTEXCEPT].pc = (memaddr)TLB_Handler;
   supp->sup_exceptContext[PGFAULTEXCEPT].status = IEPON | IMON | TEBITON;
-  supp->sup_exceptContext[PGFAULTEXCEPT].stackPtr = (memaddr)&(supp->sup_stackTLB[499]);
+  supp->sup_exceptContext[PGFAULTEXCEPT].stackPtr = (memaddr)&(supp->sup_stackTLB[SUPSTACKTOP]);
 
   /* Initialize the private page table */
   for (int i = 0; i < USERPGTBLSIZE - 1; i++) {
@@ -27,6 +27,37 @@ static inline int _is_valid_address(memaddr virtAddr, int len) {
   return (inTextData || inStack) && validLength;
 }
 
+/**
+ * @brief Returns the number of microseconds since the system was last booted/reset.
+ *
+ * @param supp Pointer to the support structure of the U-Proc.
+ */
+void getTOD(support_t* supp) {
+  cpu_t tod;
+  STCK(tod);
+  supp->sup_exceptState[GENERALEXCEPT].reg_a0 = tod;
+}
+
+/**
+ * @brief Makes the U-Proc periodic, see the SETPERIODIC kernel syscall.
+ *
+ * @param period The period in microseconds, 0 to go back to normal scheduling.
+ * @param budget The CPU time granted in every period, in microseconds.
+ * @param supp Pointer to the support structure of the U-Proc.
+ */
+void setPeriodicUProc(unsigned int period, unsigned int budget, support_t* supp) {
+  supp->sup_exceptState[GENERALEXCEPT].reg_a0 = SYSCALL(SETPERIODIC, period, budget, 0);
+}
+
+/**
+ * @brief Waits for the next period of the U-Proc, see the WAITPERIOD kernel syscall.
+ *
+ * @param supp Pointer to the support structure of the U-Proc.
+ */
+void waitPeriodUProc(support_t* supp) {
+  supp->sup_exceptState[GENERALEXCEPT].reg_a0 = SYSCALL(WAITPERIOD, 0, 0, 0);
+}
+
 /**
  * @brief terminate the U-Proc
  * This function is called when a U-Proc needs to be terminated.
@@ -193,7 +224,8 @@ void readTerminal(char* virtAddr, support_t* supp) {
  * @brief Handles system calls made by U-Processes.
  *
  * This function processes the system calls made by U-Processes based on the value of reg_a0 in the exception state.
- * It handles termination, writing to the printer, writing to the terminal, and reading from the terminal.
+ * It handles termination, writing to the printer, writing to the terminal, reading from the terminal
+ * and the periodic (EDF) scheduling requests.
  *
  * @param supp Pointer to the support structure of the U-Proc making the system call.
  */
@@ -201,6 +233,9 @@ void syscallHandler(support_t* supp) {
   state_t* state = &supp->sup_exceptState[GENERALEXCEPT];
 
   switch (state->reg_a0) {
+    case GET_TOD:
+      getTOD(supp);
+      break;
     case TERMINATE:
       terminateUProc(supp);
       break;    
@@ -213,6 +248,12 @@ void syscallHandler(support_t* supp) {
     case READTERMINAL:
       readTerminal((char*)state->reg_a1, supp);
       break;
+    case SET_PERIODIC:
+      setPeriodicUProc(state->reg_a1, state->reg_a2, supp);
+      break;
+    case WAIT_PERIOD:
+      waitPeriodUProc(supp);
+      break;
   }
   
   state->pc_epc += 4;
@@ -234,12 +275,13 @@ void programTrapExceptionHandler(support_t* supp) {
 /**
  * @brief General exception handler for U-Processes.
  *
- * This function check the cause of the exception by looking at the current support structure's exception state.
+ * This function check the cause of the exception by looking at the current support structure's exception state,
+ * found from the stack it was started on (see SUPPORT_FROM_STACK).
  * If the cause indicates a system call, it calls the syscallHandler function.
  * Otherwise, it calls the programTrapExceptionHandler function.
  */
 void generalExceptionHandler() {
-  support_t* curr_supp = (support_t*)SYSCALL(GETSUPPORTPTR, 0, 0, 0);
+  support_t* curr_supp = SUPPORT_FROM_STACK(sup_stackGen);
 
   int exception_code = curr_supp->sup_exceptState[GENERALEXCEPT].cause & GETEXECCODE;
 
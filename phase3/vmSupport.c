@@ -42,15 +42,15 @@ static inline int _getFreeSwapFrameIndex(void) {
  * @param vpn The virtual page number to access.
  * @param command The command to execute (FLASHREAD or FLASHWRITE).
  * @param starting_frame_addr The starting address of the frame to read/write.
+ * @param supp The support structure of the faulting process, terminated if the I/O fails.
  * 
  * This function performs I/O operations on the flash device.
  * It uses the ASID and VPN to determine the device and the command to execute.
  * It locks the device semaphore, performs the I/O operation, and then releases the semaphore.
  * 
  */
-static inline void _flashIO(int asid, int vpn, int command, memaddr starting_frame_addr) {
+static inline void _flashIO(int asid, int vpn, int command, memaddr starting_frame_addr, support_t* supp) {
   int dev = asid - 1; // ASID starts from 1, so we subtract 1 to get the index
-  support_t* supp = (support_t*)SYSCALL(GETSUPPORTPTR, 0, 0, 0);
   
   dtpreg_t* flash_base = (dtpreg_t*)GET_DEV_BASE(4, dev);
   flash_base->data0 = starting_frame_addr;
@@ -139,8 +139,8 @@ static inline void updateTLB_Probe(pteEntry_t* page) {
  * and handles the page fault accordingly.
  */
 void TLB_Handler(void){
-  /* Obtain the pointer to the current support structure */
-  support_t* curr_supp = (support_t*)SYSCALL(GETSUPPORTPTR, 0, 0, 0);
+  /* The support structure of the faulting process, from the stack the kernel started us on */
+  support_t* curr_supp = SUPPORT_FROM_STACK(sup_stackTLB);
 
   /* Get the current state of the exception */
   state_t* saved_exception_state = &curr_supp->sup_exceptState[PGFAULTEXCEPT];
@@ -193,12 +193,12 @@ void TLB_Handler(void){
     updateTLB_Probe(victim_page);         /* Update TLB */
 
     /* update process's backing store */
-    _flashIO(swap_entry->sw_asid, swap_entry->sw_pageNo, FLASHWRITE, frame_addr);
+    _flashIO(swap_entry->sw_asid, swap_entry->sw_pageNo, FLASHWRITE, frame_addr, curr_supp);
     enableInterrupts();
   }
 
   /* Read the contents of the current process backing store */
-  _flashIO(curr_supp->sup_asid, missing_page_num, FLASHREAD, frame_addr);
+  _flashIO(curr_supp->sup_asid, missing_page_num, FLASHREAD, frame_addr, curr_supp);
 
   /* Update the swap table entry */
   swap_entry->sw_asid = curr_supp->sup_asid;
@@ -0,0 +1,52 @@
+/*	EDF real-time test: the U-proc registers as periodic and runs a short
+ *	CPU-bound job in every period, then reports how many deadlines it missed.
+ *	Run it together with CPU-bound U-procs (e.g. fairBench) to check that the
+ *	periodic jobs keep their deadlines on a loaded machine */
+
+#include <uriscv/liburiscv.h>
+
+#include "h/tconst.h"
+#include "h/print.h"
+
+#define PERIOD	20000		/* microseconds */
+#define BUDGET	5000		/* microseconds of CPU in every period */
+#define JOBS	50
+#define FIBN	9
+
+
+int fib (int i) {
+	if ((i == 1) || (i ==2))
+		return (1);
+		
+	return(fib(i-1)+fib(i-2));
+}
+
+
+void main() {
+	int i, missed;
+	
+	print(WRITETERMINAL, "EDF test starts\n");
+	
+	if (SYSCALL(SET_PERIODIC, PERIOD, BUDGET, 0) < 0) {
+		print(WRITETERMINAL, "EDF test: periodic registration refused\n");
+		SYSCALL(TERMINATE, 0, 0, 0);
+	}
+	
+	missed = 0;
+	for (i = 0; i < JOBS; i++) {
+		fib(FIBN);
+		missed = SYSCALL(WAIT_PERIOD, 0, 0, 0);
+	}
+	
+	/* back to normal scheduling for the (slow) terminal output */
+	SYSCALL(SET_PERIODIC, 0, 0, 0);
+	
+	print(WRITETERMINAL, "EDF test deadlines missed: ");
+	printNum(WRITETERMINAL, missed);
+	print(WRITETERMINAL, " of ");
+	printNum(WRITETERMINAL, JOBS);
+	print(WRITETERMINAL, "\n");
+		
+	/* Terminate normally */	
+	SYSCALL(TERMINATE, 0, 0, 0);
+}
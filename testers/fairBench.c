@@ -0,0 +1,42 @@
+/*	Scheduler fairness benchmark: every U-proc runs CPU-bound work for a fixed
+ *	TOD window and reports how many units of work it completed.
+ *	Similar counts among the U-procs mean a fair division of the CPUs,
+ *	their sum is the throughput of the scheduler */
+
+#include <uriscv/liburiscv.h>
+
+#include "h/tconst.h"
+#include "h/print.h"
+
+#define WINDOW	2000000		/* TOD ticks of CPU-bound work */
+#define FIBN	8
+
+
+int fib (int i) {
+	if ((i == 1) || (i ==2))
+		return (1);
+		
+	return(fib(i-1)+fib(i-2));
+}
+
+
+void main() {
+	unsigned int start, work;
+	
+	print(WRITETERMINAL, "Fairness benchmark starts\n");
+	
+	work = 0;
+	start = SYSCALL(GET_TOD, 0, 0, 0);
+	
+	while ((unsigned int)SYSCALL(GET_TOD, 0, 0, 0) - start < WINDOW) {
+		fib(FIBN);
+		work++;
+	}
+	
+	print(WRITETERMINAL, "Fairness benchmark work units: ");
+	printNum(WRITETERMINAL, work);
+	print(WRITETERMINAL, "\n");
+		
+	/* Terminate normally */	
+	SYSCALL(TERMINATE, 0, 0, 0);
+}
@@ -6,3 +6,5 @@
 #define WRITEPRINTER	        3
 #define WRITETERMINAL 	        4
 #define READTERMINAL	        5
+#define SET_PERIODIC		6
+#define WAIT_PERIOD		7
@@ -0,0 +1,37 @@
+/*	Kernel lock scalability benchmark: every U-proc issues syscalls for a
+ *	fixed TOD window and reports how many it completed.
+ *	GET_TOD goes through the pass up to the support level and GETSUPPORTPTR,
+ *	which used to serialize on a single kernel lock; the periodic printer
+ *	writes add DOIO traffic on the printer interrupt line.
+ *	Run it on 8 CPUs and compare the sum of the U-procs' counts among kernels */
+
+#include <uriscv/liburiscv.h>
+
+#include "h/tconst.h"
+#include "h/print.h"
+
+#define WINDOW		2000000		/* TOD ticks of syscalls */
+#define PRINTEVERY	64		/* syscalls between two printer writes */
+
+
+void main() {
+	unsigned int start, ops;
+	
+	print(WRITETERMINAL, "Lock benchmark starts\n");
+	
+	ops = 0;
+	start = SYSCALL(GET_TOD, 0, 0, 0);
+	
+	while ((unsigned int)SYSCALL(GET_TOD, 0, 0, 0) - start < WINDOW) {
+		ops++;
+		if (ops % PRINTEVERY == 0)
+			print(WRITEPRINTER, "op\n");
+	}
+	
+	print(WRITETERMINAL, "Lock benchmark syscalls: ");
+	printNum(WRITETERMINAL, ops);
+	print(WRITETERMINAL, "\n");
+		
+	/* Terminate normally */	
+	SYSCALL(TERMINATE, 0, 0, 0);
+}
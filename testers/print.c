@@ -19,3 +19,19 @@ void print(int device, char *str) {
 		SYSCALL (TERMINATE, 0, 0, 0);
 	}
 }
+
+/* Function to print an unsigned number in decimal on a device */
+
+void printNum(int device, unsigned int num) {
+
+	char buf[11];
+	int i = 10;
+
+	buf[i] = EOS;
+	do {
+		buf[--i] = '0' + (num % 10);
+		num /= 10;
+	} while (num > 0);
+
+	print(device, &buf[i]);
+}
@@ -0,0 +1,43 @@
+/*	Scheduler scaling benchmark: CPU bursts interleaved with blocking I/O.
+ *	Every U-proc runs the same workload and reports the elapsed TOD ticks,
+ *	so that runs with different kernels and processor counts can be compared */
+
+#include <uriscv/liburiscv.h>
+
+#include "h/tconst.h"
+#include "h/print.h"
+
+#define ROUNDS	20
+#define FIBN	12
+
+
+int fib (int i) {
+	if ((i == 1) || (i ==2))
+		return (1);
+		
+	return(fib(i-1)+fib(i-2));
+}
+
+
+void main() {
+	int i;
+	unsigned int start, end;
+	
+	print(WRITETERMINAL, "Scheduler benchmark starts\n");
+	
+	start = SYSCALL(GET_TOD, 0, 0, 0);
+	
+	for (i = 0; i < ROUNDS; i++) {
+		fib(FIBN);
+		print(WRITEPRINTER, "round\n");
+	}
+	
+	end = SYSCALL(GET_TOD, 0, 0, 0);
+	
+	print(WRITETERMINAL, "Scheduler benchmark ticks: ");
+	printNum(WRITETERMINAL, end - start);
+	print(WRITETERMINAL, "\n");
+		
+	/* Terminate normally */	
+	SYSCALL(TERMINATE, 0, 0, 0);
+}